@@ -0,0 +1,105 @@
+
+// latency hiding of the batched gathers of amac.hpp as the lookups in flight K grow
+//  amac [table_size=67108864] [lookups=4194304] [repeat=3]
+//  the tables (src doubles and link indices, 1GB at the default) must be far beyond the LLC
+//  hops 1 is the gather of with*.cpp, hops 3 chases two dependent links before the load
+//  baseline is the plain loop, prefetch the gather.hpp kernel with the persisted config
+//  per row : ns per lookup and speedup over the baseline, checked against the baseline
+
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "amac.hpp"
+#include "gather.hpp"
+#include "kul/log.hpp"
+
+template <typename Fn>
+double ns_per_lookup(Fn&& fn, std::size_t lookups, std::size_t repeat){
+  double best = std::numeric_limits<double>::max();
+  for(std::size_t r = 0; r < repeat; r++){
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - start;
+    best = std::min(best, t.count() / lookups);
+  }
+  return best;
+}
+
+template <std::size_t... Ks, typename Fn>
+void for_K(std::index_sequence<Ks...>, Fn&& fn){
+  (fn(std::integral_constant<std::size_t, Ks>{}), ...);
+}
+
+int main(int argc, char* argv[]){
+  std::size_t table_size = argc > 1 ? std::atoll(argv[1]) : std::size_t{1} << 26;
+  std::size_t lookups = argc > 2 ? std::atoll(argv[2]) : std::size_t{1} << 22;
+  std::size_t repeat = argc > 3 ? std::atoll(argv[3]) : 3;
+
+  std::mt19937_64 gen{1337};
+  std::uniform_int_distribution<std::size_t> dist{0, table_size - 1};
+  std::vector<double> src(table_size);
+  std::vector<std::size_t> link(table_size), idx(lookups);
+  for(std::size_t i = 0; i < table_size; i++){
+    src[i] = i % 1024;  // small integers, so every reduction order sums exactly
+    link[i] = dist(gen);
+  }
+  for(auto& i : idx) i = dist(gen);
+
+  auto f = [](double v){ return v + v; };
+  auto plus = [](double a, double b){ return a + b; };
+  auto config = load_gather_config().value_or(GatherConfig{16, 0, -1, 1});
+  std::vector<double> dst(lookups), expected(lookups);
+  bool ok = true;
+
+  KLOG(INF) << "hops,K,mode,ns_per_lookup,speedup";
+  for(std::size_t hops : {1, 3}){
+    auto chase = [&](std::size_t i){
+      auto j = idx[i];
+      for(std::size_t h = 1; h < hops; h++) j = link[j];
+      return j;
+    };
+    auto baseline = ns_per_lookup([&](){
+      for(std::size_t i = 0; i < lookups; i++) expected[i] = f(src[chase(i)]);
+    }, lookups, repeat);
+    KLOG(INF) << hops << ",1,baseline," << baseline << ",1";
+    if(hops == 1){
+      auto t = ns_per_lookup([&](){
+        gather(src.data(), idx.data(), dst.data(), lookups, config, f);
+      }, lookups, repeat);
+      ok &= dst == expected;
+      KLOG(INF) << hops << "," << config.distance << ",prefetch," << t << "," << baseline / t;
+    }
+    double const sum = std::accumulate(expected.begin(), expected.end(), 0.);
+
+    for_K(std::index_sequence<1, 2, 4, 8, 16, 32, 64>{}, [&](auto K){
+      auto store = [&](std::size_t i, double v){ dst[i] = f(v); };
+      auto t = ns_per_lookup([&](){
+        group<K()>(src.data(), link.data(), idx.data(), lookups, hops, store);
+      }, lookups, repeat);
+      ok &= dst == expected;
+      KLOG(INF) << hops << "," << K() << ",group," << t << "," << baseline / t;
+
+      std::fill(dst.begin(), dst.end(), 0.);
+      t = ns_per_lookup([&](){
+        amac<K()>(src.data(), link.data(), idx.data(), lookups, hops, store);
+      }, lookups, repeat);
+      ok &= dst == expected;
+      KLOG(INF) << hops << "," << K() << ",amac," << t << "," << baseline / t;
+
+      if(hops == 1){
+        double reduced = 0;
+        t = ns_per_lookup([&](){
+          reduced = gather_reduce_amac<K()>(src.data(), idx.data(), lookups, 0., f, plus);
+        }, lookups, repeat);
+        ok &= reduced == sum;
+        KLOG(INF) << hops << "," << K() << ",amac_reduce," << t << "," << baseline / t;
+      }
+    });
+  }
+  KLOG(INF) << "matches baseline : " << (ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#ifndef PREFETCH_AMAC_HPP
+#define PREFETCH_AMAC_HPP
+
+// batched gathers with K independent lookups in flight, for tables far beyond the last level
+//  cache where one lookup ahead (with1.cpp) covers a fraction of the DRAM latency
+//  a lookup is idx[i] followed by hops - 1 dependent loads j = link[j] and then src[j], hops 1
+//  is the plain gather of gather.hpp. dependent loads are where the out of order window stops
+//  helping : each one waits for the last, only other lookups can fill the wait
+//  group : K lookups advance one hop together, a prefetch for each then a load for each
+//  amac  : asynchronous memory access chaining (Kocberber et al., VLDB 2015), a ring of K lookup
+//   states, each visit finishes the load its last prefetch asked for and prefetches the next
+//   one, a finished slot takes the next lookup right away so K stay in flight throughout
+// the slots are plain state machines rather than C++20 coroutines, the tree is C++17
+
+#include <array>
+#include <cstddef>
+
+namespace amac_detail {
+
+template <typename Index, typename T>
+void const* address(Index j, std::size_t hop, std::size_t hops, Index const* link, T const* src){
+  return hop < hops ? static_cast<void const*>(&link[j]) : static_cast<void const*>(&src[j]);
+}
+
+} // namespace amac_detail
+
+// op(i, src[j]) for every lookup i, in no particular order between slots
+template <std::size_t K, typename T, typename Index, typename Op>
+void amac(T const* src, Index const* link, Index const* idx, std::size_t n, std::size_t hops,
+          Op&& op){
+  using amac_detail::address;
+  constexpr auto done = static_cast<std::size_t>(-1);
+  struct Slot {
+    std::size_t i = done, hop = 0;
+    Index j{};
+  };
+  std::array<Slot, K> slots;
+  std::size_t next = 0, active = 0;
+
+  auto start = [&](Slot& s){
+    s.i = next++;
+    s.j = idx[s.i];
+    s.hop = 1;
+    __builtin_prefetch(address(s.j, s.hop, hops, link, src), 0, 0);
+  };
+  for(std::size_t k = 0; k < K && next < n; k++, active++) start(slots[k]);
+
+  while(active){
+    for(std::size_t k = 0; k < K; k++){
+      auto& s = slots[k];
+      if(s.i == done) continue;
+      if(s.hop < hops){
+        s.j = link[s.j];
+        s.hop++;
+        __builtin_prefetch(address(s.j, s.hop, hops, link, src), 0, 0);
+        continue;
+      }
+      op(s.i, src[s.j]);
+      if(next < n) start(s);
+      else {
+        s.i = done;
+        active--;
+      }
+    }
+  }
+}
+
+// lookups [first, first + K) advance hop by hop together
+template <std::size_t K, typename T, typename Index, typename Op>
+void group(T const* src, Index const* link, Index const* idx, std::size_t n, std::size_t hops,
+           Op&& op){
+  using amac_detail::address;
+  std::array<Index, K> j;
+  for(std::size_t first = 0; first < n; first += K){
+    std::size_t const size = n - first < K ? n - first : K;
+    for(std::size_t k = 0; k < size; k++){
+      j[k] = idx[first + k];
+      __builtin_prefetch(address(j[k], 1, hops, link, src), 0, 0);
+    }
+    for(std::size_t hop = 1; hop < hops; hop++)
+      for(std::size_t k = 0; k < size; k++){
+        j[k] = link[j[k]];
+        __builtin_prefetch(address(j[k], hop + 1, hops, link, src), 0, 0);
+      }
+    for(std::size_t k = 0; k < size; k++) op(first + k, src[j[k]]);
+  }
+}
+
+// dst[i] = f(src[idx[i]])
+template <std::size_t K, typename T, typename Index, typename U, typename F>
+void gather_amac(T const* src, Index const* idx, U* dst, std::size_t n, F&& f){
+  amac<K>(src, idx, idx, n, 1, [&](std::size_t i, T const& v){ dst[i] = f(v); });
+}
+
+// reduce(init, f(src[idx[i]])...), the order of the reduction depends on K
+template <std::size_t K, typename T, typename Index, typename R, typename F, typename Reduce>
+R gather_reduce_amac(T const* src, Index const* idx, std::size_t n, R init, F&& f,
+                     Reduce&& reduce){
+  amac<K>(src, idx, idx, n, 1, [&](std::size_t, T const& v){ init = reduce(init, f(v)); });
+  return init;
+}
+
+#endif /* PREFETCH_AMAC_HPP */
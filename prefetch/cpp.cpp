@@ -0,0 +1,59 @@
+
+// tunes the gather kernel of gather.hpp on this machine and keeps the best config
+//  cpp [table_size=33554432] [lookups=4194304] [repeat=3] [retune=0]
+//  the config goes to GATHER_CONFIG or ./gather.conf, later runs and other stages load it
+//  unless retune is set. with1..8.cpp are the distance 1..8 read_locality 0 write_locality 0
+//  unroll 1 rows, printed next to the without.cpp row (distance 0)
+
+#include "gather.hpp"
+#include "kul/log.hpp"
+
+int main(int argc, char* argv[]){
+  std::size_t table_size = argc > 1 ? std::atoll(argv[1]) : std::size_t{1} << 25;
+  std::size_t lookups = argc > 2 ? std::atoll(argv[2]) : std::size_t{1} << 22;
+  std::size_t repeat = argc > 3 ? std::atoll(argv[3]) : 3;
+  bool retune = argc > 4 && std::atoi(argv[4]);
+
+  { // every config against the plain loop, on lengths that leave a tail for each unroll
+    std::vector<double> src(1000), dst(997), expected(997);
+    std::iota(src.begin(), src.end(), 0.);
+    std::vector<std::size_t> idx(997);
+    for(std::size_t i = 0; i < idx.size(); i++) idx[i] = (i * 7919) % src.size();
+    for(std::size_t i = 0; i < idx.size(); i++) expected[i] = src[idx[i]] * 2;
+    for(auto const& config : gather_candidates()){
+      gather(src.data(), idx.data(), dst.data(), dst.size(), config, [](double v){ return v * 2; });
+      if(dst != expected){
+        KLOG(ERR) << "gather FAILED for " << config;
+        return 1;
+      }
+    }
+  }
+
+  auto path = gather_config_path();
+  if(auto config = load_gather_config(path); config && !retune){
+    KLOG(INF) << "config from " << path << " : " << *config;
+    return 0;
+  }
+
+  auto timings = tune_gather(table_size, lookups, repeat);
+  double none = 0;
+  std::array<double, 9> with{}; // with[d] : withd.cpp
+  for(auto const& t : timings){
+    auto const& c = t.config;
+    if(c.distance == 0 && c.unroll == 1) none = t.ns_per_lookup;
+    if(c.distance <= 8 && c.read_locality == 0 && c.write_locality == 0 && c.unroll == 1)
+      with[c.distance] = t.ns_per_lookup;
+  }
+
+  KLOG(INF) << "fastest of " << timings.size() << " configs, ns per lookup";
+  for(std::size_t i = 0; i < std::min<std::size_t>(10, timings.size()); i++)
+    KLOG(INF) << timings[i].config << " : " << timings[i].ns_per_lookup;
+  KLOG(INF) << "no prefetch          : " << none;
+  for(std::size_t d = 1; d <= 8; d++)
+    KLOG(INF) << "with" << d << "                : " << with[d];
+  KLOG(INF) << "speedup over without : " << none / timings.front().ns_per_lookup;
+
+  save_gather_config(timings.front().config, path);
+  KLOG(INF) << "saved to " << path;
+  return 0;
+}
@@ -0,0 +1,191 @@
+#ifndef PREFETCH_GATHER_HPP
+#define PREFETCH_GATHER_HPP
+
+// dst[i] = f(src[idx[i]]) with software prefetch, the with1..8.cpp programs as one kernel
+//  distance : lookups ahead to prefetch, 0 is no prefetch (without.cpp)
+//  read_locality / write_locality : __builtin_prefetch hints 0 (none) .. 3 (keep in all caches),
+//   write_locality -1 leaves dst to the hardware prefetcher, it is written in order
+//  unroll : lookups per iteration, prefetches are issued for the whole group first
+// the hints must be compile time constants, so a runtime GatherConfig dispatches to one of the
+//  instantiated kernels. tune_gather sweeps the configs on this machine and tuned_gather_config
+//  keeps the best in a file (GATHER_CONFIG or ./gather.conf) so later runs skip the sweep
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <unistd.h>
+
+struct GatherConfig {
+  std::size_t distance = 0;
+  int read_locality = 0;
+  int write_locality = -1;
+  std::size_t unroll = 1;
+};
+
+inline std::ostream& operator<<(std::ostream& os, GatherConfig const& c){
+  return os << "distance " << c.distance << " read_locality " << c.read_locality
+            << " write_locality " << c.write_locality << " unroll " << c.unroll;
+}
+
+namespace gather_detail {
+
+template <std::size_t unroll, int read_locality, int write_locality,
+          typename T, typename Index, typename U, typename F>
+void kernel(T const* src, Index const* idx, U* dst, std::size_t n, std::size_t distance, F& f){
+  std::size_t i = 0;
+  if(distance > 0){
+    // the tail without lookahead runs below, so idx[i + distance] never reads past n
+    std::size_t const prefetched = n > distance + unroll ? n - distance - unroll + 1 : 0;
+    for(; i < prefetched; i += unroll){
+      for(std::size_t u = 0; u < unroll; u++){
+        __builtin_prefetch(&src[idx[i + u + distance]], 0, read_locality);
+        if constexpr(write_locality >= 0)
+          __builtin_prefetch(&dst[i + u + distance], 1, write_locality);
+      }
+      for(std::size_t u = 0; u < unroll; u++) dst[i + u] = f(src[idx[i + u]]);
+    }
+  }
+  for(; i + unroll <= n; i += unroll)
+    for(std::size_t u = 0; u < unroll; u++) dst[i + u] = f(src[idx[i + u]]);
+  for(; i < n; i++) dst[i] = f(src[idx[i]]);
+}
+
+// calls fn(std::integral_constant<int, v>) for the v in values equal to value
+template <int... values, typename Fn>
+bool with_constant(int value, Fn&& fn){
+  return ((value == values ? (fn(std::integral_constant<int, values>{}), true) : false) || ...);
+}
+
+} // namespace gather_detail
+
+inline bool valid(GatherConfig const& c){
+  bool unroll = c.unroll == 1 || c.unroll == 2 || c.unroll == 4 || c.unroll == 8;
+  return unroll && c.read_locality >= 0 && c.read_locality <= 3 && c.write_locality >= -1
+         && c.write_locality <= 3;
+}
+
+template <typename T, typename Index, typename U, typename F>
+void gather(T const* src, Index const* idx, U* dst, std::size_t n, GatherConfig const& c, F&& f){
+  using namespace gather_detail;
+  if(!valid(c)) throw std::invalid_argument("gather: unsupported config");
+  with_constant<1, 2, 4, 8>(c.unroll, [&](auto unroll){
+    with_constant<0, 1, 2, 3>(c.read_locality, [&](auto read){
+      with_constant<-1, 0, 1, 2, 3>(c.write_locality, [&](auto write){
+        kernel<unroll(), read(), write()>(src, idx, dst, n, c.distance, f);
+      });
+    });
+  });
+}
+
+template <typename T, typename Index, typename U>
+void gather(T const* src, Index const* idx, U* dst, std::size_t n, GatherConfig const& c){
+  gather(src, idx, dst, n, c, [](T const& v){ return v; });
+}
+
+
+// the candidates of the sweep : distances 1..8 (each of with1..8.cpp) then 16, 32, 64, every
+//  read hint 0..3 and write hint -1..3, unroll 1, 2, 4, 8
+//  distance 0 ignores the hints so it is only swept over unroll
+inline std::vector<GatherConfig> gather_candidates(){
+  std::vector<GatherConfig> configs;
+  for(std::size_t unroll : {1, 2, 4, 8}) configs.push_back({0, 0, -1, unroll});
+  for(std::size_t distance : {1, 2, 3, 4, 5, 6, 7, 8, 16, 32, 64})
+    for(int read = 0; read <= 3; read++)
+      for(int write = -1; write <= 3; write++)
+        for(std::size_t unroll : {1, 2, 4, 8}) configs.push_back({distance, read, write, unroll});
+  return configs;
+}
+
+struct GatherTiming {
+  GatherConfig config;
+  double ns_per_lookup;
+};
+
+// times every candidate on random lookups into a table of table_size doubles, which should be
+//  well beyond the last level cache for the result to carry over to the real stages
+//  the fastest of repeat runs is kept per candidate, results come back fastest first
+inline std::vector<GatherTiming> tune_gather(std::size_t table_size, std::size_t lookups,
+                                             std::size_t repeat = 3){
+  std::vector<double> src(table_size), dst(lookups);
+  std::iota(src.begin(), src.end(), 0.);
+  std::vector<std::size_t> idx(lookups);
+  std::mt19937_64 gen{1337};
+  std::uniform_int_distribution<std::size_t> dist{0, table_size - 1};
+  for(auto& i : idx) i = dist(gen);
+
+  std::vector<GatherTiming> timings;
+  for(auto const& config : gather_candidates()){
+    double best = std::numeric_limits<double>::max();
+    for(std::size_t r = 0; r < repeat; r++){
+      auto start = std::chrono::steady_clock::now();
+      gather(src.data(), idx.data(), dst.data(), lookups, config,
+             [](double v){ return v + v; });
+      std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - start;
+      best = std::min(best, t.count() / lookups);
+    }
+    timings.push_back({config, best});
+  }
+  std::sort(timings.begin(), timings.end(),
+            [](auto const& a, auto const& b){ return a.ns_per_lookup < b.ns_per_lookup; });
+  return timings;
+}
+
+
+// a config only applies to the machine it was tuned on
+inline std::string gather_host(){
+  std::array<char, 256> name{};
+  gethostname(name.data(), name.size() - 1);
+  return std::string{name.data()} + "/" + std::to_string(std::thread::hardware_concurrency());
+}
+
+inline std::string gather_config_path(){
+  auto const* env = std::getenv("GATHER_CONFIG");
+  return env ? env : "gather.conf";
+}
+
+inline void save_gather_config(GatherConfig const& c,
+                               std::string const& path = gather_config_path()){
+  std::ofstream file{path};
+  file << "host " << gather_host() << "\n" << c << "\n";
+  if(!file) throw std::runtime_error("gather: cannot write " + path);
+}
+
+// nothing if the file is missing, unreadable or from another host
+inline std::optional<GatherConfig> load_gather_config(
+    std::string const& path = gather_config_path()){
+  std::ifstream file{path};
+  std::string key, host;
+  if(!(file >> key >> host) || key != "host" || host != gather_host()) return std::nullopt;
+  GatherConfig c;
+  std::string k0, k1, k2, k3;
+  if(!(file >> k0 >> c.distance >> k1 >> c.read_locality >> k2 >> c.write_locality >> k3
+           >> c.unroll)
+     || !valid(c))
+    return std::nullopt;
+  return c;
+}
+
+// the persisted config, tuned and saved on first use (32M doubles, 256MB, 4M lookups)
+inline GatherConfig tuned_gather_config(std::string const& path = gather_config_path()){
+  if(auto c = load_gather_config(path)) return *c;
+  auto best = tune_gather(std::size_t{1} << 25, std::size_t{1} << 22).front().config;
+  save_gather_config(best, path);
+  return best;
+}
+
+#endif /* PREFETCH_GATHER_HPP */
@@ -0,0 +1,82 @@
+
+// random gather with and without huge pages, the with*.cpp pattern at a size that fits here
+//  huge_pages [table_size=134217728] [lookups=16777216] [repeat=3]
+//  the default table is 1GB of doubles, well past what 4KB pages in the TLB cover (~6MB with
+//  1536 STLB entries), huge pages cover it with 512 2MB entries
+//  anon_huge_kB is AnonHugePages of /proc/self/smaps_rollup, the THP actually granted
+
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gather.hpp"
+#include "huge_pages.hpp"
+#include "kul/log.hpp"
+
+std::size_t anon_huge_kB(){
+  std::ifstream file{"/proc/self/smaps_rollup"};
+  std::string key;
+  std::size_t kB = 0;
+  while(file >> key){
+    if(key == "AnonHugePages:"){
+      file >> kB;
+      return kB;
+    }
+    file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return 0;
+}
+
+template <typename Vector>
+double ns_per_lookup(Vector& src, std::vector<std::size_t> const& idx, Vector& dst,
+                     GatherConfig const& config, std::size_t repeat){
+  double best = std::numeric_limits<double>::max();
+  for(std::size_t r = 0; r < repeat; r++){
+    auto start = std::chrono::steady_clock::now();
+    gather(src.data(), idx.data(), dst.data(), idx.size(), config, [](double v){ return v + v; });
+    std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - start;
+    best = std::min(best, t.count() / idx.size());
+  }
+  return best;
+}
+
+template <typename Vector>
+std::pair<double, double> run(std::string const& name, std::size_t table_size,
+                              std::vector<std::size_t> const& idx, GatherConfig const& config,
+                              std::size_t repeat){
+  auto const before = anon_huge_kB();
+  Vector src(table_size), dst(idx.size());
+  std::iota(src.begin(), src.end(), 0.);
+  auto const huge = anon_huge_kB() - before;
+
+  auto plain = ns_per_lookup(src, idx, dst, GatherConfig{}, repeat);
+  auto prefetched = ns_per_lookup(src, idx, dst, config, repeat);
+  KLOG(INF) << name << "," << plain << "," << prefetched << "," << huge;
+  return {plain, prefetched};
+}
+
+int main(int argc, char* argv[]){
+  std::size_t table_size = argc > 1 ? std::atoll(argv[1]) : std::size_t{1} << 27;
+  std::size_t lookups = argc > 2 ? std::atoll(argv[2]) : std::size_t{1} << 24;
+  std::size_t repeat = argc > 3 ? std::atoll(argv[3]) : 3;
+
+  std::vector<std::size_t> idx(lookups);
+  std::mt19937_64 gen{1337};
+  for(auto& i : idx) i = gen() % table_size;
+  auto config = load_gather_config().value_or(GatherConfig{16, 0, -1, 1});
+
+  KLOG(INF) << "pages,plain_ns_per_lookup,prefetch_ns_per_lookup,anon_huge_kB";
+  auto small = run<std::vector<double>>("4KB", table_size, idx, config, repeat);
+  auto huge = run<std::vector<double, HugePageAllocator<double>>>("huge", table_size, idx,
+                                                                   config, repeat);
+  auto const& stats = huge_page_stats();
+  KLOG(INF) << "huge page bytes : hugetlb " << stats.hugetlb << " transparent "
+            << stats.transparent << " plain " << stats.plain;
+  KLOG(INF) << "speedup plain " << small.first / huge.first << " prefetch "
+            << small.second / huge.second;
+  return 0;
+}
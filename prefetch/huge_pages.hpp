@@ -0,0 +1,140 @@
+#ifndef PREFETCH_HUGE_PAGES_HPP
+#define PREFETCH_HUGE_PAGES_HPP
+
+// std::allocator replacement backed by 2MB / 1GB pages for the giant arrays of the gathers and
+//  of the particle and field containers : one TLB entry covers 512 (or 262144) of the 4KB pages
+//  a random access would otherwise miss on
+//  1GB pages for 1GB and up, else 2MB pages, from the hugetlbfs pool (MAP_HUGETLB, needs pages
+//  reserved in /proc/sys/vm/nr_hugepages) when it has them, else a 2MB aligned anonymous map
+//  with madvise(MADV_HUGEPAGE) for transparent huge pages, else plain pages
+//  below huge_page_threshold (one 2MB page) it is aligned operator new, small vectors stay cheap
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+#include <sys/mman.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+constexpr std::size_t huge_page_2MB = std::size_t{1} << 21;
+constexpr std::size_t huge_page_1GB = std::size_t{1} << 30;
+constexpr std::size_t huge_page_threshold = huge_page_2MB;
+
+// bytes served by each path since the start, for the benchmarks to tell what they ran on
+struct HugePageStats {
+  std::atomic<std::size_t> hugetlb{0}, transparent{0}, plain{0};
+};
+
+inline HugePageStats& huge_page_stats(){
+  static HugePageStats stats;
+  return stats;
+}
+
+namespace huge_pages_detail {
+
+inline std::size_t rounded(std::size_t bytes, std::size_t page){
+  return (bytes + page - 1) / page * page;
+}
+
+// bytes mapped at each address : the rounding depends on the path that served the request and
+//  deallocate only gets the element count back
+struct Mappings {
+  std::mutex mutex;
+  std::unordered_map<void*, std::size_t> bytes;
+};
+
+inline Mappings& mappings(){
+  static Mappings m;
+  return m;
+}
+
+inline void* record(void* p, std::size_t bytes){
+  auto& m = mappings();
+  std::lock_guard<std::mutex> lock{m.mutex};
+  m.bytes[p] = bytes;
+  return p;
+}
+
+inline std::size_t forget(void* p){
+  auto& m = mappings();
+  std::lock_guard<std::mutex> lock{m.mutex};
+  auto const it = m.bytes.find(p);
+  auto const bytes = it->second;
+  m.bytes.erase(it);
+  return bytes;
+}
+
+inline void* map_hugetlb(std::size_t bytes, int log2_page){
+  int const flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (log2_page << MAP_HUGE_SHIFT);
+  void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+  return p == MAP_FAILED ? nullptr : p;
+}
+
+// over map by one 2MB page and trim, THP only backs 2MB aligned ranges
+inline void* map_transparent(std::size_t bytes, bool& advised){
+  void* p = mmap(nullptr, bytes + huge_page_2MB, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(p == MAP_FAILED) return nullptr;
+  auto const start = reinterpret_cast<std::uintptr_t>(p);
+  auto const aligned = (start + huge_page_2MB - 1) / huge_page_2MB * huge_page_2MB;
+  if(aligned > start) munmap(p, aligned - start);
+  if(auto tail = start + huge_page_2MB - aligned; tail > 0)
+    munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+  advised = madvise(reinterpret_cast<void*>(aligned), bytes, MADV_HUGEPAGE) == 0;
+  return reinterpret_cast<void*>(aligned);
+}
+
+} // namespace huge_pages_detail
+
+template <typename T>
+struct HugePageAllocator {
+  using value_type = T;
+
+  HugePageAllocator() = default;
+  template <typename U>
+  HugePageAllocator(HugePageAllocator<U> const&){}
+
+  T* allocate(std::size_t n){
+    using namespace huge_pages_detail;
+    auto const bytes = n * sizeof(T);
+    if(bytes < huge_page_threshold)
+      return static_cast<T*>(::operator new(bytes, std::align_val_t{alignof(T)}));
+
+    auto& stats = huge_page_stats();
+    for(int log2_page : {30, 21}){
+      auto const page = std::size_t{1} << log2_page;
+      if(page == huge_page_1GB && bytes < huge_page_1GB) continue;
+      auto const size = rounded(bytes, page);
+      if(void* p = map_hugetlb(size, log2_page)){
+        stats.hugetlb += size;
+        return static_cast<T*>(record(p, size));
+      }
+    }
+    bool advised = false;
+    auto const size = rounded(bytes, huge_page_2MB);
+    if(void* p = map_transparent(size, advised)){
+      (advised ? stats.transparent : stats.plain) += size;
+      return static_cast<T*>(record(p, size));
+    }
+    throw std::bad_alloc{};
+  }
+
+  void deallocate(T* p, std::size_t n){
+    auto const bytes = n * sizeof(T);
+    if(bytes < huge_page_threshold) ::operator delete(p, std::align_val_t{alignof(T)});
+    else munmap(p, huge_pages_detail::forget(p));
+  }
+};
+
+template <typename T, typename U>
+bool operator==(HugePageAllocator<T> const&, HugePageAllocator<U> const&){ return true; }
+template <typename T, typename U>
+bool operator!=(HugePageAllocator<T> const&, HugePageAllocator<U> const&){ return false; }
+
+#endif /* PREFETCH_HUGE_PAGES_HPP */
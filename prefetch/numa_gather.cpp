@@ -0,0 +1,53 @@
+
+// threaded random gather, lookups/s against thread count for each NUMA placement of the table
+//  numa_gather [table_size=134217728] [lookups=33554432] [max_threads=allowed cpus] [repeat=3]
+//  the default table is 1GB of doubles, only the table is placed, idx and dst are streamed
+//  and stay where the main thread touched them. the prefetch config is the persisted one of
+//  gather.hpp, throughput is the best of repeat runs
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "numa_gather.hpp"
+#include "kul/log.hpp"
+
+int main(int argc, char* argv[]){
+  std::size_t table_size = argc > 1 ? std::atoll(argv[1]) : std::size_t{1} << 27;
+  std::size_t lookups = argc > 2 ? std::atoll(argv[2]) : std::size_t{1} << 25;
+  std::size_t max_threads = argc > 3 ? std::atoll(argv[3]) : numa_cpus();
+  std::size_t repeat = argc > 4 ? std::atoll(argv[4]) : 3;
+
+  auto config = load_gather_config().value_or(GatherConfig{16, 0, -1, 1});
+  std::vector<std::size_t> idx(lookups);
+  std::vector<double> dst(lookups);
+  std::mt19937_64 gen{1337};
+  for(auto& i : idx) i = gen() % table_size;
+  auto value = [](std::size_t i){ return static_cast<double>(i % 1024); };
+  auto f = [](double v){ return v + v; };
+
+  KLOG(INF) << numa_nodes() << " NUMA nodes, " << numa_cpus() << " cpus, " << config;
+  KLOG(INF) << "placement,threads,Mlookups_per_s,speedup";
+  bool ok = true;
+  for(auto placement : {NumaPlacement::interleaved, NumaPlacement::replicated,
+                        NumaPlacement::first_touch}){
+    NumaTable<double> table{table_size, placement, max_threads, value};
+    if(table.placement() != placement)
+      KLOG(INF) << name(placement) << " : mbind failed, the table is " << name(table.placement());
+    double single = 0;
+    for(std::size_t nthreads = 1; nthreads <= max_threads; nthreads++){
+      double best = 0;
+      for(std::size_t r = 0; r < repeat; r++){
+        auto start = std::chrono::steady_clock::now();
+        gather_threaded(table, idx.data(), dst.data(), lookups, nthreads, config, f);
+        std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+        best = std::max(best, lookups / t.count());
+      }
+      if(nthreads == 1) single = best;
+      for(std::size_t i = 0; i < lookups; i += 4099) ok &= dst[i] == f(value(idx[i]));
+      KLOG(INF) << name(placement) << "," << nthreads << "," << best / 1e6 << "," << best / single;
+    }
+  }
+  KLOG(INF) << "matches table[idx] : " << (ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
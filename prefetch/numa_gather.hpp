@@ -0,0 +1,237 @@
+#ifndef PREFETCH_NUMA_GATHER_HPP
+#define PREFETCH_NUMA_GATHER_HPP
+
+// threaded random gather from a table placed across NUMA nodes. one thread keeps ~10 misses in
+//  flight, throughput from an 80GB table only grows with threads each running their own
+//  prefetch stream (the gather.hpp kernel) over a contiguous chunk of the lookups
+//  interleaved : pages round robin over the nodes, every thread sees the average latency and
+//   the load spreads over all memory controllers
+//  replicated : one copy per node, threads read the copy of the node they run on, all local
+//   for nodes times the memory
+//  first_touch : each thread writes its own slice of the table first so the pages land on its
+//   node, lookups are random so most are still remote with more than one node
+// threads are pinned to the cpus of the process affinity mask, round robin over the nodes from
+//  the sysfs cpulists, placement goes through the mbind syscall so no libnuma is needed, on one
+//  node all three are the same memory
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "gather.hpp"
+
+enum class NumaPlacement { interleaved, replicated, first_touch };
+
+inline char const* name(NumaPlacement placement){
+  switch(placement){
+    case NumaPlacement::interleaved: return "interleaved";
+    case NumaPlacement::replicated: return "replicated";
+    default: return "first_touch";
+  }
+}
+
+namespace numa_detail {
+
+constexpr int mpol_bind = 2, mpol_interleave = 3; // linux/mempolicy.h
+constexpr int max_node = 64;                      // width of the mbind masks here
+
+inline bool mbind(void* p, std::size_t bytes, int mode, std::uint64_t nodes){
+  return syscall(SYS_mbind, p, bytes, mode, &nodes, max_node, 0) == 0;
+}
+
+inline int current_node(){
+  unsigned cpu = 0, node = 0;
+  syscall(SYS_getcpu, &cpu, &node, nullptr);
+  return node;
+}
+
+// "0-3,8,10-11" as in the sysfs cpulist files
+inline std::vector<int> parse_cpulist(std::string const& list){
+  std::vector<int> cpus;
+  std::istringstream ranges{list};
+  for(std::string range; std::getline(ranges, range, ',');){
+    if(range.empty() || !std::isdigit(static_cast<unsigned char>(range[0]))) continue;
+    auto const dash = range.find('-');
+    int const first = std::stoi(range.substr(0, dash));
+    int const last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for(int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// the ids of the nodeN directories that have memory (the has_memory list, same format as a
+//  cpulist, all of them on kernels without it), they need not be contiguous, {0} without sysfs
+inline std::vector<int> node_ids(){
+  std::vector<int> ids;
+  std::error_code ec;
+  for(auto const& entry : std::filesystem::directory_iterator{"/sys/devices/system/node", ec}){
+    auto const name = entry.path().filename().string();
+    if(name.size() > 4 && name.compare(0, 4, "node") == 0
+       && std::all_of(name.begin() + 4, name.end(), [](char c){ return std::isdigit(c); }))
+      if(auto id = std::stoi(name.substr(4)); id < max_node) ids.push_back(id);
+  }
+  if(std::ifstream file{"/sys/devices/system/node/has_memory"}){
+    std::string list;
+    std::getline(file, list);
+    auto const with_memory = parse_cpulist(list);
+    ids.erase(std::remove_if(ids.begin(), ids.end(), [&](int id){
+      return std::find(with_memory.begin(), with_memory.end(), id) == with_memory.end();
+    }), ids.end());
+  }
+  std::sort(ids.begin(), ids.end());
+  if(ids.empty()) ids.push_back(0);
+  return ids;
+}
+
+// the cpus of the process affinity mask, round robin over the nodes : cpu t of the list is
+//  on node t % nodes (while every node has cpus left), so the first threads spread over nodes
+inline std::vector<int> thread_cpus(){
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+
+  std::vector<std::vector<int>> per_node;
+  std::vector<bool> placed(CPU_SETSIZE, false);
+  for(int node : node_ids()){
+    std::ifstream file{"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"};
+    std::string list;
+    std::getline(file, list);
+    std::vector<int> cpus;
+    for(int cpu : parse_cpulist(list))
+      if(cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed) && !placed[cpu]){
+        cpus.push_back(cpu);
+        placed[cpu] = true;
+      }
+    if(!cpus.empty()) per_node.push_back(std::move(cpus));
+  }
+  std::vector<int> rest; // allowed cpus in no node cpulist, all of them without sysfs
+  for(int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    if(CPU_ISSET(cpu, &allowed) && !placed[cpu]) rest.push_back(cpu);
+  if(!rest.empty()) per_node.push_back(std::move(rest));
+
+  std::vector<int> order;
+  for(std::size_t k = 0, added = 1; added; k++){
+    added = 0;
+    for(auto const& cpus : per_node)
+      if(k < cpus.size()){
+        order.push_back(cpus[k]);
+        added++;
+      }
+  }
+  return order;
+}
+
+inline void pin(int cpu){
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  sched_setaffinity(0, sizeof(set), &set);
+}
+
+// runs fn(t) on nthreads threads, thread t pinned to thread_cpus()[t], wrapping when there are
+//  more threads than allowed cpus. t = 0 on the calling thread (pinned for the duration)
+template <typename Fn>
+void pinned(std::size_t nthreads, Fn&& fn){
+  static std::vector<int> const cpus = thread_cpus();
+  cpu_set_t before;
+  sched_getaffinity(0, sizeof(before), &before);
+  std::vector<std::thread> threads;
+  for(std::size_t t = 1; t < nthreads; t++)
+    threads.emplace_back([&, t](){
+      pin(cpus[t % cpus.size()]);
+      fn(t);
+    });
+  pin(cpus[0]);
+  fn(0);
+  for(auto& thread : threads) thread.join();
+  sched_setaffinity(0, sizeof(before), &before);
+}
+
+} // namespace numa_detail
+
+// nodes with memory, capped at the 64 of the mbind masks here
+inline std::size_t numa_nodes(){ return numa_detail::node_ids().size(); }
+
+// cpus the threads can be pinned to, the process affinity mask
+inline std::size_t numa_cpus(){ return numa_detail::thread_cpus().size(); }
+
+// size values, value(i) at i, placed by the policy, nthreads fill it for first_touch
+template <typename T = double>
+class NumaTable {
+ public:
+  template <typename Value>
+  NumaTable(std::size_t size, NumaPlacement placement, std::size_t nthreads, Value&& value)
+      : size_{size}, bytes_{size * sizeof(T)}, placement_{placement}{
+    using namespace numa_detail;
+    auto const ids = node_ids();
+    std::uint64_t all = 0;
+    for(int id : ids) all |= std::uint64_t{1} << id;
+    nodes_ = placement == NumaPlacement::replicated ? ids : std::vector<int>{ids.front()};
+    copies_.resize(nodes_.size());
+    for(std::size_t c = 0; c < copies_.size(); c++){
+      auto const flags = MAP_PRIVATE | MAP_ANONYMOUS;
+      void* p = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, flags, -1, 0);
+      if(p == MAP_FAILED) throw std::bad_alloc{};
+      madvise(p, bytes_, MADV_HUGEPAGE);
+      bool bound = true;
+      if(placement == NumaPlacement::interleaved) bound = mbind(p, bytes_, mpol_interleave, all);
+      if(placement == NumaPlacement::replicated)
+        bound = mbind(p, bytes_, mpol_bind, std::uint64_t{1} << nodes_[c]);
+      // without the policy (no mbind in a container, a node gone offline) pages are first touch
+      if(!bound) placement_ = NumaPlacement::first_touch;
+      copies_[c] = static_cast<T*>(p);
+    }
+    // first touch from the pinned threads, the policies above take precedence where set
+    pinned(nthreads, [&](std::size_t t){
+      for(auto* copy : copies_)
+        for(std::size_t i = size * t / nthreads; i < size * (t + 1) / nthreads; i++)
+          copy[i] = value(i);
+    });
+  }
+  NumaTable(NumaTable const&) = delete;
+  NumaTable& operator=(NumaTable const&) = delete;
+  ~NumaTable(){
+    for(auto* copy : copies_) munmap(copy, bytes_);
+  }
+
+  // the copy closest to the calling thread
+  T const* local() const {
+    if(copies_.size() == 1) return copies_[0];
+    auto const node = std::find(nodes_.begin(), nodes_.end(), numa_detail::current_node());
+    return node == nodes_.end() ? copies_[0] : copies_[node - nodes_.begin()];
+  }
+  std::size_t size() const { return size_; }
+  // the placement in effect, first_touch when mbind failed for any copy
+  NumaPlacement placement() const { return placement_; }
+
+ private:
+  std::size_t size_, bytes_;
+  NumaPlacement placement_;
+  std::vector<int> nodes_; // node of each copy
+  std::vector<T*> copies_;
+};
+
+// dst[i] = f(table[idx[i]]) on nthreads pinned threads, each a contiguous chunk of the lookups
+template <typename T, typename Index, typename U, typename F>
+void gather_threaded(NumaTable<T> const& table, Index const* idx, U* dst, std::size_t n,
+                     std::size_t nthreads, GatherConfig const& config, F&& f){
+  numa_detail::pinned(nthreads, [&](std::size_t t){
+    auto const first = n * t / nthreads, last = n * (t + 1) / nthreads;
+    gather(table.local(), idx + first, dst + first, last - first, config, f);
+  });
+}
+
+#endif /* PREFETCH_NUMA_GATHER_HPP */
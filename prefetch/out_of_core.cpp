@@ -0,0 +1,76 @@
+
+// the with*.cpp gather out of core, src and idx written to files then gathered through
+//  gather_out_of_core in blocks sized to the RAM budget
+//  out_of_core [n=1e8] [ram_MB=available/4] [dir=.]
+//  n doubles of src, n uint64 of idx and n doubles of dst go to dir, plus up to 16 bytes per
+//  lookup of bucket and result files while it runs, SIZE = 9876543210 takes ~400GB of disk
+//  ram_MB must be at least 1 (out_of_core_min_ram), smaller budgets mean smaller blocks and
+//  more partition passes once the blocks outnumber the open bucket files (fanout)
+//  the files are flushed and dropped from the page cache before the gather, so io is the disk
+
+#include <random>
+#include <vector>
+
+#include "out_of_core.hpp"
+#include "kul/log.hpp"
+
+// written by chunks, flushed and evicted so the gather starts from disk
+template <typename Fill>
+void write_file(std::string const& path, std::size_t n, Fill&& fill){
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0) throw std::runtime_error("cannot open " + path);
+  std::vector<decltype(fill(0))> chunk(std::size_t{1} << 20);
+  for(std::size_t first = 0; first < n; first += chunk.size()){
+    auto const size = std::min(chunk.size(), n - first);
+    for(std::size_t i = 0; i < size; i++) chunk[i] = fill(first + i);
+    auto bytes = size * sizeof(chunk[0]);
+    if(static_cast<std::size_t>(write(fd, chunk.data(), bytes)) != bytes)
+      throw std::runtime_error("cannot write " + path);
+  }
+  fsync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+}
+
+int main(int argc, char* argv[]){
+  std::size_t n = argc > 1 ? std::atof(argv[1]) : 1e8;
+  std::size_t available = sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+  std::size_t ram = argc > 2 ? std::atof(argv[2]) * (1 << 20) : available / 4;
+  std::string dir = argc > 3 ? argv[3] : ".";
+  if(ram < out_of_core_min_ram){
+    KLOG(ERR) << "ram_MB below the " << (out_of_core_min_ram >> 20) << "MB minimum";
+    return 1;
+  }
+  auto src_path = dir + "/src.bin", idx_path = dir + "/idx.bin", dst_path = dir + "/dst.bin";
+
+  std::mt19937_64 gen{1337};
+  write_file(src_path, n, [](std::size_t i){ return static_cast<double>(i % 1024); });
+  write_file(idx_path, n, [&](std::size_t){ return static_cast<std::uint64_t>(gen() % n); });
+
+  auto stats = gather_out_of_core(src_path, idx_path, dst_path, ram, dir,
+                                  [](double v){ return v + v; });
+
+  bool ok = true;
+  { // spot checks through the files
+    MappedFile src{src_path}, idx{idx_path}, dst{dst_path};
+    auto const* values = src.data<double const>();
+    auto const* indices = idx.data<std::uint64_t const>();
+    for(std::size_t s = 0; s < 100000; s++){
+      auto i = gen() % n;
+      ok &= dst.data<double const>()[i] == 2 * values[indices[i]];
+    }
+  }
+  unlink(src_path.c_str());
+  unlink(idx_path.c_str());
+  unlink(dst_path.c_str());
+
+  KLOG(INF) << "n,ram_MB,blocks,dst_blocks,fanout,passes,partition_s,gather_s,scatter_s,io_s,"
+               "io_wait_s,overlap,Mlookups_per_s";
+  KLOG(INF) << n << "," << (ram >> 20) << "," << stats.blocks << "," << stats.dst_blocks << ","
+            << stats.fanout << "," << stats.passes << "," << stats.partition << ","
+            << stats.gather << "," << stats.scatter << "," << stats.io << "," << stats.io_wait
+            << "," << stats.overlap() << ","
+            << n / (stats.partition + stats.gather + stats.scatter) / 1e6;
+  KLOG(INF) << "matches src[idx] : " << (ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,384 @@
+#ifndef PREFETCH_OUT_OF_CORE_HPP
+#define PREFETCH_OUT_OF_CORE_HPP
+
+// the gather dst[i] = f(src[idx[i]]) on files larger than memory, for SIZE = 9876543210
+//  src, idx and dst are memory mapped files, src and dst are processed in blocks that fit the
+//  RAM budget, every access to a file is sequential or within the block in memory
+//  partition : one pass over idx appends each (position, index) to the bucket file of the src
+//   block index falls in, so every block needs just its own lookups
+//  gather : block by block, the (position, f(src[index])) of the block's bucket are appended
+//   to the result file of the dst block position falls in. while a block is gathered a
+//   readahead thread faults in the next block and bucket (madvise / posix_fadvise WILLNEED
+//   then a touch per page), so reading overlaps compute
+//  scatter : dst block by dst block, the block's results are written into it and the block is
+//   synced and dropped, so dst is written once, in order
+// both partitions keep at most fanout bucket files open, fanout from the RAM budget and the
+//  open file limit : with more blocks than that, pairs go to fanout group files first and each
+//  group file is split again, one more pass over the pairs per level
+// budget, each phase within ram_bytes :
+//  partition : fanout buffers in half, the idx chunk being read in a quarter
+//  gather : result buffers in a quarter, the src block and its bucket (16 bytes per lookup, at
+//   the mean lookups per element) double buffered in the rest
+//  scatter : the dst block and its results (16 bytes per element) in half
+//  ram_bytes must be at least out_of_core_min_ram, smaller budgets only cost more passes
+// the time the compute waits on the readahead is io_wait, overlap is the share of the readahead
+//  hidden behind compute
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class MappedFile {
+ public:
+  // size 0 maps the existing file read only, otherwise the file is created with size bytes
+  MappedFile(std::string const& path, std::size_t size = 0) : writable_{size > 0}{
+    fd_ = writable_ ? open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)
+                    : open(path.c_str(), O_RDONLY);
+    if(fd_ < 0) throw std::runtime_error("MappedFile: cannot open " + path);
+    if(writable_ && ftruncate(fd_, size) != 0)
+      throw std::runtime_error("MappedFile: cannot resize " + path);
+    struct stat st;
+    fstat(fd_, &st);
+    size_ = st.st_size;
+    if(size_ == 0) return;
+    auto const protection = writable_ ? PROT_READ | PROT_WRITE : PROT_READ;
+    data_ = mmap(nullptr, size_, protection, MAP_SHARED, fd_, 0);
+    if(data_ == MAP_FAILED) throw std::runtime_error("MappedFile: cannot map " + path);
+  }
+  MappedFile(MappedFile const&) = delete;
+  MappedFile& operator=(MappedFile const&) = delete;
+  ~MappedFile(){
+    if(data_ && data_ != MAP_FAILED) munmap(data_, size_);
+    if(fd_ >= 0) close(fd_);
+  }
+
+  template <typename T>
+  T* data() const { return static_cast<T*>(data_); }
+  std::size_t size() const { return size_; }
+  int fd() const { return fd_; }
+
+  // the page aligned cover of [offset, offset + bytes)
+  void advise(std::size_t offset, std::size_t bytes, int advice) const {
+    if(!data_ || offset >= size_) return;
+    auto const [start, length] = cover(offset, bytes);
+    madvise(start, length, advice);
+  }
+
+  // drops the range from the mapping, keeps the resident set to the budget. a writable range
+  //  is written back first
+  void release(std::size_t offset, std::size_t bytes) const {
+    if(!data_ || offset >= size_) return;
+    auto const [start, length] = cover(offset, bytes);
+    if(writable_) msync(start, length, MS_SYNC);
+    madvise(start, length, MADV_DONTNEED);
+  }
+
+ private:
+  std::pair<void*, std::size_t> cover(std::size_t offset, std::size_t bytes) const {
+    auto const page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    auto const first = offset / page * page;
+    bytes = std::min(bytes + offset - first, size_ - first);
+    return {static_cast<char*>(data_) + first, bytes};
+  }
+
+  int fd_ = -1;
+  bool writable_;
+  void* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+struct IndexPair {
+  std::uint64_t position, index;
+};
+
+struct PositionValue {
+  std::uint64_t position;
+  double value;
+};
+
+struct OutOfCoreStats {
+  std::size_t blocks = 0, dst_blocks = 0, fanout = 0, passes = 0;
+  double partition = 0, gather = 0, scatter = 0, io = 0, io_wait = 0;
+
+  // share of the readahead time that did not hold up the compute
+  double overlap() const { return io > 0 ? std::clamp(1 - io_wait / io, 0., 1.) : 1; }
+};
+
+constexpr std::size_t out_of_core_min_ram = std::size_t{1} << 20;
+
+namespace out_of_core_detail {
+
+constexpr std::size_t min_buffer = std::size_t{64} << 10; // bytes per bucket buffer
+constexpr std::size_t max_fanout = 256;
+
+inline double since(std::chrono::steady_clock::time_point start){
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// asks for the range then reads one byte per page, returns when it is resident
+inline void fault_in(char const* data, std::size_t bytes){
+  if(bytes == 0) return;
+  auto const page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  auto const first = reinterpret_cast<std::uintptr_t>(data) / page * page;
+  auto const cover = bytes + reinterpret_cast<std::uintptr_t>(data) - first;
+  madvise(reinterpret_cast<void*>(first), cover, MADV_WILLNEED);
+  volatile char sink = 0;
+  for(std::size_t b = 0; b < bytes; b += page) sink = sink + data[b];
+}
+
+// bucket files open at once : within the open file limit, less what the caller holds, and
+//  buffers of at least min_buffer in buffer_budget
+inline std::size_t fanout(std::size_t buffer_budget){
+  rlimit limit{};
+  getrlimit(RLIMIT_NOFILE, &limit);
+  std::size_t files = limit.rlim_cur == RLIM_INFINITY ? max_fanout : limit.rlim_cur;
+  files = files > 64 ? files - 32 : files / 2;
+  return std::max<std::size_t>(2, std::min({max_fanout, files, buffer_budget / min_buffer}));
+}
+
+// buffered appends to a set of bucket files
+template <typename Pair>
+class BucketWriter {
+ public:
+  BucketWriter(std::vector<std::string> paths, std::size_t buffer_bytes)
+      : paths_{std::move(paths)}, buffered_{std::max<std::size_t>(
+                                      buffer_bytes / sizeof(Pair), 1)},
+        buffers_(paths_.size()){
+    for(auto const& path : paths_){
+      files_.push_back(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+      if(files_.back() < 0) throw std::runtime_error("gather_out_of_core: cannot open " + path);
+    }
+    for(auto& buffer : buffers_) buffer.reserve(buffered_);
+  }
+  BucketWriter(BucketWriter const&) = delete;
+  BucketWriter& operator=(BucketWriter const&) = delete;
+  ~BucketWriter(){
+    for(auto fd : files_) close(fd);
+  }
+
+  void push(std::size_t bucket, Pair const& pair){
+    buffers_[bucket].push_back(pair);
+    if(buffers_[bucket].size() == buffered_) flush(bucket);
+  }
+  void flush(){
+    for(std::size_t b = 0; b < buffers_.size(); b++) flush(b);
+  }
+
+ private:
+  void flush(std::size_t b){
+    auto const bytes = buffers_[b].size() * sizeof(Pair);
+    if(static_cast<std::size_t>(write(files_[b], buffers_[b].data(), bytes)) != bytes)
+      throw std::runtime_error("gather_out_of_core: cannot write " + paths_[b]);
+    buffers_[b].clear();
+  }
+
+  std::vector<std::string> paths_;
+  std::size_t buffered_;
+  std::vector<std::vector<Pair>> buffers_;
+  std::vector<int> files_;
+};
+
+// how a partition runs : leaf(k) is the file of key k, group files are named after tag
+struct Partition {
+  std::string scratch_dir, tag;
+  std::size_t fanout, buffer_bytes, chunk_bytes;
+
+  std::string leaf(std::size_t key) const {
+    return scratch_dir + "/" + tag + "_" + std::to_string(key) + ".bin";
+  }
+  std::string group(std::size_t first, std::size_t last) const {
+    return scratch_dir + "/" + tag + "_" + std::to_string(first) + "-" + std::to_string(last)
+           + ".bin";
+  }
+};
+
+// calls push(pair) for the pairs of the file, read chunk by chunk and dropped behind
+template <typename Pair>
+auto file_feed(std::string const& path, std::size_t chunk_bytes){
+  return [=](auto&& push){
+    MappedFile file{path};
+    auto const* pairs = file.data<Pair const>();
+    auto const n = file.size() / sizeof(Pair);
+    auto const chunk = std::max<std::size_t>(chunk_bytes / sizeof(Pair), 1);
+    file.advise(0, file.size(), MADV_SEQUENTIAL);
+    for(std::size_t first = 0; first < n; first += chunk){
+      auto const last = std::min(n, first + chunk);
+      for(std::size_t i = first; i < last; i++) push(pairs[i]);
+      file.release(first * sizeof(Pair), (last - first) * sizeof(Pair));
+    }
+  };
+}
+
+// the pairs feed(push) gives, with key(pair) in [first, last), into the files p.leaf(k)
+//  at most p.fanout files are open : a range wider than that goes to p.fanout group files of
+//  consecutive keys, each then split the same way. returns the passes over the pairs
+template <typename Pair, typename Feed, typename Key>
+std::size_t partition(Feed&& feed, Key const& key, std::size_t first, std::size_t last,
+                      Partition const& p){
+  auto const width = (last - first + p.fanout - 1) / p.fanout; // keys per group
+  auto const groups = (last - first + width - 1) / width;
+  std::vector<std::string> paths;
+  for(std::size_t g = 0; g < groups; g++){
+    auto const lo = first + g * width, hi = std::min(last, lo + width);
+    paths.push_back(width == 1 ? p.leaf(lo) : p.group(lo, hi));
+  }
+  {
+    BucketWriter<Pair> writer{paths, p.buffer_bytes};
+    feed([&](Pair const& pair){ writer.push((key(pair) - first) / width, pair); });
+    writer.flush();
+  }
+  if(width == 1) return 1;
+  std::size_t passes = 0;
+  for(std::size_t g = 0; g < groups; g++){
+    auto const lo = first + g * width, hi = std::min(last, lo + width);
+    passes = std::max(passes, partition<Pair>(file_feed<Pair>(paths[g], p.chunk_bytes), key, lo,
+                                              hi, p));
+    unlink(paths[g].c_str());
+  }
+  return passes + 1;
+}
+
+} // namespace out_of_core_detail
+
+// idx_path : n uint64 indices into src_path (doubles), dst_path gets the n results
+//  ram_bytes : budget of every phase, see the top of the file, at least out_of_core_min_ram
+//  scratch_dir : where the bucket and result files go, they take 16 bytes per lookup each, the
+//   buckets are removed as the gather goes, the results as the scatter goes
+template <typename F>
+OutOfCoreStats gather_out_of_core(std::string const& src_path, std::string const& idx_path,
+                                  std::string const& dst_path, std::size_t ram_bytes,
+                                  std::string const& scratch_dir, F&& f){
+  using namespace out_of_core_detail;
+  if(ram_bytes < out_of_core_min_ram)
+    throw std::invalid_argument("gather_out_of_core: ram_bytes below out_of_core_min_ram");
+  OutOfCoreStats stats;
+  MappedFile src{src_path}, idx{idx_path};
+  auto const n_src = src.size() / sizeof(double);
+  auto const n = idx.size() / sizeof(std::uint64_t);
+  if(n_src == 0 && n > 0) throw std::invalid_argument("gather_out_of_core: empty src");
+  constexpr std::size_t page_doubles = 512; // blocks of whole 4KB pages
+
+  // src block and its bucket, twice, in 3/8 of the budget each
+  auto const lookups_per_element = static_cast<double>(n) / std::max<std::size_t>(n_src, 1);
+  auto const block_bytes_per_element = sizeof(double) + sizeof(IndexPair) * lookups_per_element;
+  auto const block = std::max<std::size_t>(
+      static_cast<std::size_t>(3. / 8 * ram_bytes / block_bytes_per_element) / page_doubles
+          * page_doubles,
+      page_doubles);
+  // dst block and its results in half the budget
+  auto const dst_block = std::max<std::size_t>(
+      ram_bytes / 2 / (sizeof(double) + sizeof(PositionValue)) / page_doubles * page_doubles,
+      page_doubles);
+  stats.blocks = std::max<std::size_t>((n_src + block - 1) / block, 1);
+  stats.dst_blocks = std::max<std::size_t>((n + dst_block - 1) / dst_block, 1);
+  stats.fanout = fanout(ram_bytes / 2);
+
+  Partition const buckets{scratch_dir, "bucket", stats.fanout, ram_bytes / 2 / stats.fanout,
+                          ram_bytes / 4};
+  Partition const results{scratch_dir, "result", stats.fanout, ram_bytes / 4 / stats.fanout,
+                          ram_bytes / 4};
+
+  { // partition, idx streamed by chunks, buckets appended through the fanout buffers
+    auto start = std::chrono::steady_clock::now();
+    auto const* indices = idx.data<std::uint64_t const>();
+    auto const chunk = buckets.chunk_bytes / sizeof(std::uint64_t);
+    auto feed = [&](auto&& push){
+      idx.advise(0, idx.size(), MADV_SEQUENTIAL);
+      for(std::size_t first = 0; first < n; first += chunk){
+        auto const last = std::min(n, first + chunk);
+        for(std::size_t i = first; i < last; i++) push(IndexPair{i, indices[i]});
+        idx.release(first * sizeof(std::uint64_t), (last - first) * sizeof(std::uint64_t));
+      }
+    };
+    auto key = [&](IndexPair const& pair){ return pair.index / block; };
+    stats.passes = partition<IndexPair>(feed, key, 0, stats.blocks, buckets);
+    stats.partition = since(start);
+  }
+
+  auto const* table = src.data<char const>();
+  auto const block_bytes = [&](std::size_t b){
+    return (std::min(n_src, (b + 1) * block) - std::min(n_src, b * block)) * sizeof(double);
+  };
+
+  { // gather, the results partitioned by dst block as they come
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<MappedFile> bucket, next_bucket;
+    auto readahead = [&](std::size_t b){
+      auto io_start = std::chrono::steady_clock::now();
+      next_bucket = std::make_unique<MappedFile>(buckets.leaf(b));
+      posix_fadvise(next_bucket->fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+      if(block_bytes(b)) fault_in(table + b * block * sizeof(double), block_bytes(b));
+      fault_in(next_bucket->data<char const>(), next_bucket->size());
+      return since(io_start);
+    };
+    auto feed = [&](auto&& push){
+      stats.io += readahead(0); // nothing to overlap the first block with
+      stats.io_wait = stats.io;
+      for(std::size_t b = 0; b < stats.blocks; b++){
+        bucket = std::move(next_bucket);
+        double io = 0;
+        std::chrono::steady_clock::time_point done;
+        std::thread reader;
+        if(b + 1 < stats.blocks)
+          reader = std::thread{[&](){
+            io = readahead(b + 1);
+            done = std::chrono::steady_clock::now();
+          }};
+
+        auto const* pairs = bucket->data<IndexPair const>();
+        auto const count = bucket->size() / sizeof(IndexPair);
+        auto const* values = reinterpret_cast<double const*>(table);
+        for(std::size_t k = 0; k < count; k++)
+          push(PositionValue{pairs[k].position, f(values[pairs[k].index])});
+
+        if(reader.joinable()){
+          // only the time the reader still ran once the compute was done
+          auto const wait_start = std::chrono::steady_clock::now();
+          reader.join();
+          stats.io_wait += std::max(0., std::chrono::duration<double>(done - wait_start).count());
+          stats.io += io;
+        }
+        src.release(b * block * sizeof(double), block_bytes(b));
+        bucket.reset();
+        unlink(buckets.leaf(b).c_str());
+      }
+    };
+    auto key = [&](PositionValue const& pair){ return pair.position / dst_block; };
+    stats.passes += partition<PositionValue>(feed, key, 0, stats.dst_blocks, results);
+    stats.gather = since(start);
+  }
+
+  { // scatter, dst written block by block in order and dropped once synced
+    auto start = std::chrono::steady_clock::now();
+    MappedFile dst{dst_path, std::max<std::size_t>(n, 1) * sizeof(double)};
+    auto* out = dst.data<double>();
+    for(std::size_t d = 0; d < stats.dst_blocks; d++){
+      {
+        MappedFile result{results.leaf(d)};
+        auto const* pairs = result.data<PositionValue const>();
+        auto const count = result.size() / sizeof(PositionValue);
+        for(std::size_t k = 0; k < count; k++) out[pairs[k].position] = pairs[k].value;
+      }
+      unlink(results.leaf(d).c_str());
+      auto const first = std::min(n, d * dst_block), last = std::min(n, (d + 1) * dst_block);
+      dst.release(first * sizeof(double), (last - first) * sizeof(double));
+    }
+    stats.scatter = since(start);
+  }
+  return stats;
+}
+
+#endif /* PREFETCH_OUT_OF_CORE_HPP */
@@ -0,0 +1,84 @@
+
+// index generation for with*.cpp, values/s of each way to fill n indices in [0, n - 1]
+//  random_fill [n=1e8] [max_threads=all cpus]
+//  get        : Random::get + emplace_back, what with*.cpp did. every call constructs the
+//   seeder_default, a std::random_device read, so it is timed on at most 1e6 values
+//  get_fast   : the same with random_fast (xoshiro256** engine), still one call per value
+//  mt19937_64 : one engine and distribution, reserved vector
+//  fill       : fill_uniform on 1 .. max_threads threads, checked identical for every count
+
+#include <chrono>
+#include <vector>
+
+#include "random_fill.hpp"
+#include "kul/log.hpp"
+
+template <typename Fn>
+double values_per_second(std::size_t n, Fn&& fn){
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+  return n / t.count();
+}
+
+int main(int argc, char* argv[]){
+  std::size_t n = argc > 1 ? std::atof(argv[1]) : 1e8;
+  std::size_t max_threads = argc > 2 ? std::atoll(argv[2]) : std::thread::hardware_concurrency();
+  std::size_t const hi = n - 1;
+  std::size_t const sample = std::min<std::size_t>(n, 1e6);
+
+  KLOG(INF) << "method,threads,Mvalues_per_s";
+  {
+    std::vector<size_t> indices;
+    auto rate = values_per_second(sample, [&](){
+      for(size_t i = 0; i < sample; i++)
+        indices.emplace_back(effolkronium::random_static::get<std::size_t>(0, hi));
+    });
+    KLOG(INF) << "get,1," << rate / 1e6;
+  }
+  {
+    std::vector<size_t> indices;
+    auto rate = values_per_second(sample, [&](){
+      for(size_t i = 0; i < sample; i++)
+        indices.emplace_back(effolkronium::random_fast::get<std::size_t>(0, hi));
+    });
+    KLOG(INF) << "get_fast,1," << rate / 1e6;
+  }
+  {
+    std::vector<size_t> indices;
+    indices.reserve(n);
+    auto rate = values_per_second(n, [&](){
+      std::mt19937_64 gen{1337};
+      std::uniform_int_distribution<std::size_t> dist{0, hi};
+      for(size_t i = 0; i < n; i++) indices.push_back(dist(gen));
+    });
+    KLOG(INF) << "mt19937_64,1," << rate / 1e6;
+  }
+
+  std::vector<size_t> indices(n), reference;
+  bool ok = true;
+  for(std::size_t threads = 1; threads <= max_threads; threads++){
+    auto rate = values_per_second(n, [&](){
+      effolkronium::fill_uniform(indices, std::size_t{0}, hi, 1337, threads);
+    });
+    if(reference.empty()) reference = indices;
+    ok &= indices == reference;
+    KLOG(INF) << "fill," << threads << "," << rate / 1e6;
+  }
+
+  double mean = 0, doubles_mean = 0;
+  for(auto i : indices){
+    ok &= i <= hi;
+    mean += static_cast<double>(i) / n;
+  }
+  std::vector<double> doubles(n);
+  effolkronium::fill_uniform(doubles, -1., 1.);
+  for(auto d : doubles){
+    ok &= d >= -1 && d < 1;
+    doubles_mean += d / n;
+  }
+  KLOG(INF) << "mean / hi " << mean / hi << " (0.5), doubles in [-1, 1) mean " << doubles_mean
+            << " (0)";
+  KLOG(INF) << "in range and identical for all thread counts : " << (ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
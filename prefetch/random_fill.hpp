@@ -0,0 +1,171 @@
+#ifndef EFFOLKRONIUM_RANDOM_FILL_HPP
+#define EFFOLKRONIUM_RANDOM_FILL_HPP
+
+// bulk uniform fills next to the per call Random::get of random.hpp, which costs a global
+//  mt19937 step and a distribution construction per value
+//  xoshiro256** (Blackman & Vigna) : shifts, rotates and multiplies by 5 and 9, so lanes of
+//  independent generators vectorize, and jump() advances 2^128 steps for disjoint streams
+//  fill_uniform cuts the array into blocks of fill_block_size values, block b is generated by
+//  fill_lanes streams started at jump^(b * fill_lanes) of the seed, so the values depend on the
+//  seed only, not on the thread count. each thread jumps to its first block then walks on
+//  integers : Lemire's multiply-shift, 32 bit (vectorizable) for ranges up to 2^32 and 128 bit
+//   above, without the rejection step so the bias is at most range / 2^32 (or 2^64) per value
+//  reals : the top 53 (24) bits scaled into [lo, hi)
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "random.hpp"
+
+namespace effolkronium {
+
+class xoshiro256ss {
+ public:
+  using result_type = std::uint64_t;
+
+  explicit xoshiro256ss(std::uint64_t seed = 1337){
+    for(auto& s : s_){ // splitmix64, so no seed leaves the state all zero
+      seed += 0x9e3779b97f4a7c15;
+      auto z = seed;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      s = z ^ (z >> 31);
+    }
+  }
+  // for the Seeder of basic_random_static, random_fast below
+  template <typename Sseq, typename = decltype(std::declval<Sseq&>().generate(
+                               std::declval<std::uint32_t*>(), std::declval<std::uint32_t*>()))>
+  explicit xoshiro256ss(Sseq& seq){
+    std::array<std::uint32_t, 8> words;
+    seq.generate(words.begin(), words.end());
+    for(std::size_t i = 0; i < 4; i++)
+      s_[i] = (std::uint64_t{words[2 * i]} << 32) | words[2 * i + 1];
+    if((s_[0] | s_[1] | s_[2] | s_[3]) == 0) s_[0] = 1;
+  }
+
+  static constexpr result_type min(){ return 0; }
+  static constexpr result_type max(){ return std::numeric_limits<result_type>::max(); }
+
+  result_type operator()(){
+    auto const result = rotl(s_[1] * 5, 7) * 9;
+    auto const t = s_[1] << 17;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = rotl(s_[3], 45);
+    return result;
+  }
+
+  // 2^128 calls ahead
+  void jump(){
+    constexpr std::uint64_t polynomial[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c,
+                                            0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+    std::array<std::uint64_t, 4> s{};
+    for(auto word : polynomial)
+      for(int b = 0; b < 64; b++){
+        if(word & (std::uint64_t{1} << b))
+          for(std::size_t i = 0; i < 4; i++) s[i] ^= s_[i];
+        (*this)();
+      }
+    s_ = s;
+  }
+
+ private:
+  static std::uint64_t rotl(std::uint64_t x, int k){ return (x << k) | (x >> (64 - k)); }
+  std::array<std::uint64_t, 4> s_;
+};
+
+/// Random::get with xoshiro256** in place of mt19937
+using random_fast = basic_random_static<xoshiro256ss>;
+
+namespace details {
+
+constexpr std::size_t fill_lanes = 8;
+constexpr std::size_t fill_block_size = std::size_t{1} << 16;
+
+// lanes interleaved : value i of the block comes from lane i % lanes
+template <typename T, typename Map>
+void fill_block(std::array<xoshiro256ss, fill_lanes>& lanes, T* out, std::size_t n, Map& map){
+  std::size_t i = 0;
+  for(; i + fill_lanes <= n; i += fill_lanes)
+    for(std::size_t l = 0; l < fill_lanes; l++) out[i + l] = map(lanes[l]());
+  for(std::size_t l = 0; i < n; i++, l++) out[i] = map(lanes[l]());
+}
+
+// fills [data, data + n) block by block, map turns a 64 bit draw into a value
+template <typename T, typename Map>
+void fill_mapped(T* data, std::size_t n, std::uint64_t seed, std::size_t nthreads, Map const& map){
+  auto const blocks = (n + fill_block_size - 1) / fill_block_size;
+  nthreads = std::max<std::size_t>(1, std::min(nthreads, blocks));
+
+  auto fill = [&](std::size_t t){
+    auto const first = blocks * t / nthreads, last = blocks * (t + 1) / nthreads;
+    xoshiro256ss next{seed};
+    for(std::size_t j = 0; j < first * fill_lanes; j++) next.jump();
+    auto local_map = map;
+    std::array<xoshiro256ss, fill_lanes> lanes{next, next, next, next, next, next, next, next};
+    for(std::size_t b = first; b < last; b++){
+      for(auto& lane : lanes){
+        lane = next;
+        next.jump();
+      }
+      auto const begin = b * fill_block_size;
+      fill_block(lanes, data + begin, std::min(fill_block_size, n - begin), local_map);
+    }
+  };
+  std::vector<std::thread> threads;
+  for(std::size_t t = 1; t < nthreads; t++) threads.emplace_back(fill, t);
+  fill(0);
+  for(auto& thread : threads) thread.join();
+}
+
+} // namespace details
+
+/// Fill [data, data + n) with uniform values in [lo, hi] (integers) or [lo, hi) (reals)
+/// \note The values depend on seed only, any nthreads gives the same array
+template <typename T>
+void fill_uniform(T* data, std::size_t n, T lo, T hi, std::uint64_t seed = 1337,
+                  std::size_t nthreads = std::thread::hardware_concurrency()){
+  using details::fill_mapped;
+  if constexpr(std::is_floating_point<T>::value){
+    constexpr int bits = std::numeric_limits<T>::digits;
+    T const scale = (hi - lo) / static_cast<T>(std::uint64_t{1} << bits);
+    fill_mapped(data, n, seed, nthreads,
+                [=](std::uint64_t x){ return lo + static_cast<T>(x >> (64 - bits)) * scale; });
+  } else {
+    using U = std::make_unsigned_t<T>;
+    auto const base = static_cast<U>(lo);
+    auto const span = static_cast<std::uint64_t>(static_cast<U>(hi) - base); // range - 1
+    auto value = [=](std::uint64_t offset){ return static_cast<T>(base + static_cast<U>(offset)); };
+    if(span < (std::uint64_t{1} << 32))
+      fill_mapped(data, n, seed, nthreads,
+                  [=](std::uint64_t x){ return value(((x >> 32) * (span + 1)) >> 32); });
+    else if(span == std::numeric_limits<std::uint64_t>::max())
+      fill_mapped(data, n, seed, nthreads, value);
+    else
+      fill_mapped(data, n, seed, nthreads, [=](std::uint64_t x){
+        auto const wide = static_cast<unsigned __int128>(x) * (span + 1);
+        return value(static_cast<std::uint64_t>(wide >> 64));
+      });
+  }
+}
+
+/// Container overload, fill_uniform(indices, size_t{0}, SIZE - 1)
+template <typename Container>
+void fill_uniform(Container& values, typename Container::value_type lo,
+                  typename Container::value_type hi, std::uint64_t seed = 1337,
+                  std::size_t nthreads = std::thread::hardware_concurrency()){
+  fill_uniform(values.data(), values.size(), lo, hi, seed, nthreads);
+}
+
+} // namespace effolkronium
+
+#endif // #ifndef EFFOLKRONIUM_RANDOM_FILL_HPP
@@ -0,0 +1,101 @@
+
+// sort-then-gather against the prefetching gather, table and lookups of n doubles as in
+//  with*.cpp, for n = min_n, 3 min_n, 9 min_n .. max_n and 1, 4 and 16 gathers with the same idx
+//  sort_gather [min_n=1e7] [max_n=1e10]
+//  memory is ~5.5 x 8 bytes per element below 2^32 (uint32 plans), ~8 x 8 bytes above, so
+//  1e10 needs ~600GB. sizes beyond the available memory are skipped, on a 64GB machine the
+//  default sweep is 1e7, 3e7, 9e7, 2.7e8, 8.1e8. choice is choose_gather_path with the costs
+//  measured up front, right tells whether it picked the faster of the two totals
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+#include "sort_gather.hpp"
+#include "kul/log.hpp"
+
+template <typename Fn>
+double seconds(Fn&& fn){
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// position weighted, so a result in the wrong place changes it
+double checksum(std::vector<double> const& v){
+  double sum = 0;
+  for(std::size_t i = 0; i < v.size(); i++) sum += (i % 7 + 1) * v[i];
+  return sum;
+}
+
+// bytes the run of n elements needs, from the estimate above
+std::size_t run_bytes(std::size_t n){
+  return n < (std::size_t{1} << 32) ? n * 44 : n * 64;
+}
+
+std::size_t available_bytes(){
+  return static_cast<std::size_t>(sysconf(_SC_AVPHYS_PAGES))
+         * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+template <typename Index>
+bool run(std::size_t n, GatherConfig const& config, GatherCosts const& costs){
+  std::vector<double> src(n), dst(n);
+  std::vector<Index> idx(n);
+  std::mt19937_64 gen{1337};
+  for(std::size_t i = 0; i < n; i++){
+    src[i] = i % 1024;
+    idx[i] = gen() % n;
+  }
+  auto f = [](double v){ return v + v; };
+
+  auto prefetch = seconds([&](){ gather(src.data(), idx.data(), dst.data(), n, config, f); });
+  auto expected = checksum(dst);
+  std::fill(dst.begin(), dst.end(), 0.);
+
+  std::vector<double> sorted(2);
+  std::unique_ptr<SortedGather<Index>> plan;
+  sorted[0] = seconds([&](){ plan = std::make_unique<SortedGather<Index>>(idx.data(), n); });
+  sorted[1] = seconds([&](){ (*plan)(src.data(), dst.data(), f); });
+  plan.reset();
+  bool ok = checksum(dst) == expected;
+
+  for(std::size_t reuses : {1, 4, 16}){
+    auto path = choose_gather_path(n, reuses, n * sizeof(double), n * sizeof(double), costs);
+    auto tprefetch = reuses * prefetch, tsorted = sorted[0] + reuses * sorted[1];
+    bool right = (path == GatherPath::sorted) == (tsorted < tprefetch);
+    KLOG(INF) << n << "," << reuses << "," << tprefetch << "," << sorted[0] << "," << tsorted
+              << "," << tprefetch / tsorted << ","
+              << (path == GatherPath::sorted ? "sorted" : "prefetch") << "," << right;
+  }
+  return ok;
+}
+
+int main(int argc, char* argv[]){
+  std::size_t min_n = argc > 1 ? std::atof(argv[1]) : 1e7;
+  std::size_t max_n = argc > 2 ? std::atof(argv[2]) : 1e10;
+
+  auto config = load_gather_config().value_or(GatherConfig{16, 0, -1, 1});
+  auto costs = measure_gather_costs(config);
+  KLOG(INF) << "ns per element : random_load " << costs.random_load << " cached_load "
+            << costs.cached_load << " random_store " << costs.random_store << " stream "
+            << costs.stream << " sort " << costs.sort << ", llc " << costs.llc_bytes;
+
+  bool ok = true;
+  KLOG(INF) << "n,reuses,prefetch_s,sort_s,sorted_s,speedup,choice,right";
+  for(std::size_t n = min_n; n <= max_n; n *= 3){
+    if(run_bytes(n) > available_bytes()){
+      KLOG(INF) << n << " skipped, needs " << run_bytes(n) << " bytes, " << available_bytes()
+                << " available";
+      break;
+    }
+    if(n < (std::size_t{1} << 32)) ok &= run<std::uint32_t>(n, config, costs);
+    else ok &= run<std::uint64_t>(n, config, costs);
+  }
+  KLOG(INF) << "sorted matches prefetch : " << (ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+#ifndef PREFETCH_SORT_GATHER_HPP
+#define PREFETCH_SORT_GATHER_HPP
+
+// sort once, gather many : for an idx that is reused, the (index, position) pairs are radix
+//  sorted by index once, each gather then reads src in monotone address order and writes the
+//  results back through position. the sorted reads share cache lines and DRAM pages and run
+//  ahead of the hardware prefetcher, the cost moves to the scattered stores, which do not
+//  stall the loads the way the random loads of the plain gather do
+// choose_gather_path weighs the one off sort against the saving per gather, with costs measured
+//  on this machine by measure_gather_costs
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "gather.hpp"
+
+template <typename Index>
+struct IndexPosition {
+  Index index, position;
+};
+
+// stable LSD radix sort on index, 8 bit digits, only the digits below max_index are sorted
+//  each pass : per thread digit counts over a contiguous chunk, offsets digit major then thread
+//  major so the chunks keep their order, then every thread scatters its own chunk
+template <typename Index>
+void radix_sort_pairs(std::vector<IndexPosition<Index>>& pairs, Index max_index,
+                      std::size_t nthreads = std::thread::hardware_concurrency()){
+  constexpr std::size_t radix = 256;
+  auto const n = pairs.size();
+  nthreads = std::max<std::size_t>(1, std::min<std::size_t>(nthreads, n / 65536 + 1));
+  std::vector<IndexPosition<Index>> buffer(n);
+  std::vector<std::array<std::size_t, radix>> offsets(nthreads);
+  auto chunk = [&](std::size_t t){
+    return std::make_pair(n * t / nthreads, n * (t + 1) / nthreads);
+  };
+  auto parallel = [&](auto&& fn){
+    std::vector<std::thread> threads;
+    for(std::size_t t = 1; t < nthreads; t++) threads.emplace_back(fn, t);
+    fn(0);
+    for(auto& thread : threads) thread.join();
+  };
+
+  for(std::size_t shift = 0; shift < sizeof(Index) * 8 && (max_index >> shift) > 0; shift += 8){
+    parallel([&](std::size_t t){
+      auto& count = offsets[t];
+      count.fill(0);
+      auto [first, last] = chunk(t);
+      for(std::size_t i = first; i < last; i++) count[(pairs[i].index >> shift) & 0xff]++;
+    });
+    std::size_t sum = 0;
+    for(std::size_t digit = 0; digit < radix; digit++)
+      for(std::size_t t = 0; t < nthreads; t++){
+        auto count = offsets[t][digit];
+        offsets[t][digit] = sum;
+        sum += count;
+      }
+    parallel([&](std::size_t t){
+      auto& offset = offsets[t];
+      auto [first, last] = chunk(t);
+      for(std::size_t i = first; i < last; i++)
+        buffer[offset[(pairs[i].index >> shift) & 0xff]++] = pairs[i];
+    });
+    pairs.swap(buffer);
+  }
+}
+
+// the sorted plan of one idx, Index must hold both the table size and the lookup count
+template <typename Index = std::uint32_t>
+struct SortedGather {
+  template <typename I>
+  SortedGather(I const* idx, std::size_t n,
+               std::size_t nthreads = std::thread::hardware_concurrency()){
+    std::vector<IndexPosition<Index>> pairs(n);
+    Index max_index = 0;
+    for(std::size_t i = 0; i < n; i++){
+      pairs[i] = {static_cast<Index>(idx[i]), static_cast<Index>(i)};
+      max_index = std::max(max_index, pairs[i].index);
+    }
+    radix_sort_pairs(pairs, max_index, nthreads);
+    index.resize(n);
+    position.resize(n);
+    for(std::size_t k = 0; k < n; k++){
+      index[k] = pairs[k].index;
+      position[k] = pairs[k].position;
+    }
+  }
+
+  // dst[i] = f(src[idx[i]]) for the idx of the constructor
+  template <typename T, typename U, typename F>
+  void operator()(T const* src, U* dst, F&& f) const {
+    for(std::size_t k = 0; k < index.size(); k++) dst[position[k]] = f(src[index[k]]);
+  }
+
+  std::vector<Index> index, position;
+};
+
+
+enum class GatherPath { prefetch, sorted };
+
+// ns per element, random_* with the table or dst far beyond the last level cache
+struct GatherCosts {
+  double random_load = 20, cached_load = 1, random_store = 5, stream = 0.2, sort = 3;
+  std::size_t llc_bytes = std::size_t{32} << 20;
+};
+
+inline std::size_t last_level_cache_bytes(){
+  std::size_t bytes = 0;
+  for(int level = 0; level < 8; level++){
+    std::ifstream file{"/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(level)
+                       + "/size"};
+    std::size_t size = 0;
+    char unit = 'K';
+    if(file >> size >> unit)
+      bytes = std::max(bytes, size << (unit == 'M' ? 20 : unit == 'G' ? 30 : 10));
+  }
+  return bytes ? bytes : GatherCosts{}.llc_bytes;
+}
+
+// a table of 4x the LLC (at most 1GB), 1M lookups, the plain and the sorted gather on it
+inline GatherCosts measure_gather_costs(GatherConfig const& config = GatherConfig{16, 0, -1, 1}){
+  GatherCosts c;
+  c.llc_bytes = last_level_cache_bytes();
+  std::size_t const table_size = std::min(4 * c.llc_bytes, std::size_t{1} << 30) / sizeof(double);
+  std::size_t const lookups = std::size_t{1} << 20;
+  std::size_t const cached = c.llc_bytes / 4 / sizeof(double);
+
+  std::vector<double> src(table_size, 1.), dst(std::max(table_size, lookups));
+  std::vector<std::size_t> idx(lookups), cached_idx(lookups), positions(lookups);
+  std::mt19937_64 gen{1337};
+  for(std::size_t i = 0; i < lookups; i++){
+    idx[i] = gen() % table_size;
+    cached_idx[i] = gen() % cached;
+    positions[i] = gen() % table_size;
+  }
+  auto ns = [&](auto&& fn){
+    double best = std::numeric_limits<double>::max();
+    for(int r = 0; r < 3; r++){
+      auto start = std::chrono::steady_clock::now();
+      fn();
+      std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - start;
+      best = std::min(best, t.count() / lookups);
+    }
+    return best;
+  };
+  auto copy = [](double v){ return v; };
+  c.random_load = ns([&](){ gather(src.data(), idx.data(), dst.data(), lookups, config, copy); });
+  c.cached_load
+      = ns([&](){ gather(src.data(), cached_idx.data(), dst.data(), lookups, config, copy); });
+  c.random_store = ns([&](){
+    for(std::size_t i = 0; i < lookups; i++) dst[positions[i]] = src[i];
+  });
+  c.stream = ns([&](){ std::copy(src.begin(), src.begin() + lookups, dst.begin()); });
+  c.sort = ns([&](){ SortedGather<std::uint32_t>{idx.data(), lookups}; });
+  return c;
+}
+
+// lookups into a table of table_bytes, the results into dst of dst_bytes, reuses gathers with
+//  the same idx : sorting pays off when the per gather saving covers the sort over the reuses
+inline GatherPath choose_gather_path(std::size_t lookups, std::size_t reuses,
+                                     std::size_t table_bytes, std::size_t dst_bytes,
+                                     GatherCosts const& c){
+  auto const load = table_bytes > c.llc_bytes ? c.random_load : c.cached_load;
+  // a sorted lookup reads its share of the table span, no more than one random load
+  auto const span
+      = static_cast<double>(table_bytes) / sizeof(double) / std::max<std::size_t>(lookups, 1);
+  auto const sorted_load = std::min(load, c.stream * span + c.cached_load);
+  auto const store = dst_bytes > c.llc_bytes ? c.random_store : c.cached_load;
+  double const prefetch = reuses * load;
+  double const sorted = c.sort + reuses * (sorted_load + store);
+  return sorted < prefetch ? GatherPath::sorted : GatherPath::prefetch;
+}
+
+#endif /* PREFETCH_SORT_GATHER_HPP */
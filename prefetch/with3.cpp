@@ -1,5 +1,6 @@
 
 #include "random.hpp"
+#include "random_fill.hpp"
 #include "kul/log.hpp"
 
 using Random = effolkronium::random_static;
@@ -17,10 +18,8 @@ int main(int argc, char* argv[]){
       d1[i] = i + ((i+i)*i);
     }
 
-    std::vector<size_t> indices;
-    for(size_t i = 0; i < SIZE; i++){
-      indices.emplace_back(Random::get(0, (int)SIZE - 1));
-    }
+    std::vector<size_t> indices(SIZE);
+    effolkronium::fill_uniform(indices, size_t{0}, SIZE - 1);
 
     size_t d1_i = 0;
     for(size_t i = 0; i < SIZE; i++){
@@ -0,0 +1,139 @@
+#ifndef SPARSE_BITMAP_HPP
+#define SPARSE_BITMAP_HPP
+
+// occupancy of a rows x cols table of doubles, one bit per slot in place of the 8 bytes the
+//  dense scan reads : row r is the words [r * row_words, (r + 1) * row_words), bit c % 64 of word
+//  c / 64 set when slot (r, c) is non zero
+//  summary (optional) : one bit per row, set when the row has any entry, the scan walks the
+//   summary words and never touches the words of empty rows
+// of() builds each word from the 4 (AVX2) or 8 (AVX-512) wide compare masks of row_scan.hpp,
+//  the isa picked once at runtime, other types and the partial last word compare one slot at a time
+// set bits are visited with tzcnt (__builtin_ctzll) and cleared with x & (x - 1), so the cost
+//  follows the entries and not the slots, count() is a popcount per word
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "row_scan.hpp"
+
+namespace bitmap_detail {
+
+// bit b set when row[b] != 0, b < 64, from the compare masks of row_scan (NaN counts, -0.0 not)
+__attribute__((target("avx2"))) inline std::uint64_t word_avx2(double const* row){
+  std::uint64_t word = 0;
+  for(std::size_t b = 0; b < 64; b += 4)
+    word |= std::uint64_t{row_scan_detail::nonzero4(row, b)} << b;
+  return word;
+}
+
+__attribute__((target("avx512f"))) inline std::uint64_t word_avx512(double const* row){
+  std::uint64_t word = 0;
+  for(std::size_t b = 0; b < 64; b += 8)
+    word |= std::uint64_t{row_scan_detail::nonzero8(row, b)} << b;
+  return word;
+}
+
+// the first "last" slots, one bit per slot
+template <typename T>
+std::uint64_t word(T const* row, std::size_t last){
+  std::uint64_t word = 0;
+  for(std::size_t b = 0; b < last; b++) word |= std::uint64_t{row[b] != 0} << b;
+  return word;
+}
+
+// a whole word of 64 slots, doubles through the widest compare the cpu has
+template <typename T>
+std::uint64_t word(T const* row, RowScanIsa isa){
+  if constexpr (std::is_same_v<T, double>){
+    if(isa == RowScanIsa::avx512) return word_avx512(row);
+    if(isa == RowScanIsa::avx2) return word_avx2(row);
+  }
+  return word(row, 64);
+}
+
+} // namespace bitmap_detail
+
+class OccupancyBitmap {
+ public:
+  OccupancyBitmap(std::size_t rows, std::size_t cols, bool summary = true)
+      : rows_{rows}, cols_{cols}, row_words_{(cols + 63) / 64}, bits_(rows * row_words_),
+        summary_(summary ? (rows + 63) / 64 : 0){}
+
+  // the non zero slots of a dense row major table
+  template <typename T>
+  static OccupancyBitmap of(T const* data, std::size_t rows, std::size_t cols,
+                            bool summary = true){
+    static RowScanIsa const isa = row_scan_isa();
+    OccupancyBitmap bitmap{rows, cols, summary};
+    for(std::size_t r = 0; r < rows; r++){
+      auto const* row = data + r * cols;
+      auto* words = bitmap.bits_.data() + r * bitmap.row_words_;
+      std::uint64_t any = 0;
+      for(std::size_t w = 0; w < bitmap.row_words_; w++){
+        auto const last = std::min<std::size_t>(64, cols - w * 64);
+        words[w] = last == 64 ? bitmap_detail::word(row + w * 64, isa)
+                              : bitmap_detail::word(row + w * 64, last);
+        any |= words[w];
+      }
+      if(any && bitmap.summarized()) bitmap.summary_[r / 64] |= std::uint64_t{1} << (r % 64);
+    }
+    return bitmap;
+  }
+
+  void set(std::size_t r, std::size_t c){
+    bits_[r * row_words_ + c / 64] |= std::uint64_t{1} << (c % 64);
+    if(summarized()) summary_[r / 64] |= std::uint64_t{1} << (r % 64);
+  }
+  void reset(std::size_t r, std::size_t c){
+    bits_[r * row_words_ + c / 64] &= ~(std::uint64_t{1} << (c % 64));
+    if(!summarized()) return;
+    auto const* words = bits_.data() + r * row_words_;
+    for(std::size_t w = 0; w < row_words_; w++)
+      if(words[w]) return;
+    summary_[r / 64] &= ~(std::uint64_t{1} << (r % 64));
+  }
+  bool test(std::size_t r, std::size_t c) const {
+    return (bits_[r * row_words_ + c / 64] >> (c % 64)) & 1;
+  }
+
+  std::size_t count() const {
+    std::size_t n = 0;
+    for(auto word : bits_) n += __builtin_popcountll(word);
+    return n;
+  }
+
+  // fn(c) for the set slots of row r, in column order
+  template <typename Fn>
+  void for_each_in_row(std::size_t r, Fn&& fn) const {
+    auto const* words = bits_.data() + r * row_words_;
+    for(std::size_t w = 0; w < row_words_; w++)
+      for(auto word = words[w]; word; word &= word - 1)
+        fn(w * 64 + __builtin_ctzll(word));
+  }
+
+  // fn(r, c) for all set slots, row major
+  template <typename Fn>
+  void for_each(Fn&& fn) const {
+    auto row = [&](std::size_t r){ for_each_in_row(r, [&](std::size_t c){ fn(r, c); }); };
+    if(!summarized()){
+      for(std::size_t r = 0; r < rows_; r++) row(r);
+      return;
+    }
+    for(std::size_t s = 0; s < summary_.size(); s++)
+      for(auto word = summary_[s]; word; word &= word - 1) row(s * 64 + __builtin_ctzll(word));
+  }
+
+  bool summarized() const { return !summary_.empty(); }
+  std::size_t rows() const { return rows_; }
+  std::size_t cols() const { return cols_; }
+  std::size_t bytes() const { return (bits_.size() + summary_.size()) * sizeof(std::uint64_t); }
+
+ private:
+  std::size_t rows_, cols_, row_words_;
+  std::vector<std::uint64_t> bits_, summary_;
+};
+
+#endif /* SPARSE_BITMAP_HPP */
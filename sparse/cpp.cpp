@@ -1,7 +1,12 @@
 
 #include <atomic>
+#include <random>
+#include <string>
+#include <vector>
 
+#include "bitmap.hpp"
 #include "random.hpp"
+#include "row_scan.hpp"
 #include "kul/log.hpp"
 #include "kul/time.hpp"
 #include "kul/threads.hpp"
@@ -60,6 +65,65 @@ void seq(const size_t i, double d[][SIZE], size_t& test){
   for(size_t j = 0; j < SIZE; j++) if(d[i][j]) test += i + j;
 }
 
+// seq with the non zero test vectorized, AVX-512 / AVX2 / scalar picked from CPUID
+void simd(const size_t i, double d[][SIZE], size_t& test){
+  scan_row(d[i], SIZE, i, test);
+}
+
+// seq over the occupancy bits of row i, only the set slots are visited
+void bitmap(const size_t i, OccupancyBitmap const& bits, size_t& test){
+  bits.for_each_in_row(i, [&](size_t j){ test += i + j; });
+}
+
+// seq against the bitmap on a SIZE * SIZE x SIZE table filled at each density, times in ns
+//  build   : OccupancyBitmap::of the dense table, paid once while the table does not change
+//  rows    : bitmap() row by row, every row word is read
+//  summary : for_each over the summary bits, empty rows are skipped
+//  simd    : simd() on the dense table, no bitmap to build
+void density_sweep(){
+  std::vector<double> table(SIZE * SIZE * SIZE);
+  auto d = reinterpret_cast<double (*)[SIZE]>(table.data());
+  std::mt19937_64 gen(1337);
+  // break even : rescans of the table before building the bitmap pays off, the build over what
+  //  the faster bitmap scan saves on each against the faster dense scan, never when it saves none
+  KLOG(INF) << "density %, seq, simd, build, rows, summary, break even, bitmap bytes, "
+               "dense bytes, match";
+  for(double p : {0.0001, 0.001, 0.01, 0.1, 0.5}){
+    std::bernoulli_distribution occupied(p);
+    for(auto& v : table) v = occupied(gen);
+    size_t expected = 0, vectorized = 0, rows = 0, summary = 0;
+
+    auto now = kul::Now::NANOS();
+    for(size_t i = 0; i < SIZE * SIZE; i++) seq(i, d, expected);
+    auto t_seq = kul::Now::NANOS() - now;
+
+    now = kul::Now::NANOS();
+    for(size_t i = 0; i < SIZE * SIZE; i++) simd(i, d, vectorized);
+    auto t_simd = kul::Now::NANOS() - now;
+
+    now = kul::Now::NANOS();
+    auto bits = OccupancyBitmap::of(table.data(), SIZE * SIZE, SIZE);
+    auto t_build = kul::Now::NANOS() - now;
+
+    now = kul::Now::NANOS();
+    for(size_t i = 0; i < SIZE * SIZE; i++) bitmap(i, bits, rows);
+    auto t_rows = kul::Now::NANOS() - now;
+
+    now = kul::Now::NANOS();
+    bits.for_each([&](size_t i, size_t j){ summary += i + j; });
+    auto t_summary = kul::Now::NANOS() - now;
+
+    auto const dense = std::min(t_seq, t_simd), sparse = std::min(t_rows, t_summary);
+    auto const break_even = dense > sparse
+        ? std::to_string((t_build + dense - sparse - 1) / (dense - sparse)) : std::string{"never"};
+
+    bool match = vectorized == expected && rows == expected && summary == expected;
+    KLOG(INF) << p * 100 << ", " << t_seq << ", " << t_simd << ", " << t_build << ", "
+              << t_rows << ", " << t_summary << ", " << break_even << ", " << bits.bytes() << ", "
+              << table.size() * sizeof(double) << ", " << (match ? "ok" : "FAILED");
+  }
+}
+
 int main(int argc, char* argv[]){
   double d [SIZE * SIZE][SIZE]={0};
 
@@ -135,8 +199,34 @@ int main(int argc, char* argv[]){
   KLOG(INF) << "time for seq           : " << (kul::Now::NANOS() - now);
   KLOG(INF) << "found value            : " << (test);
   KLOG(INF);
+  size_t const seq_test = test;
   test = 0;
 
+  KLOG(INF) << "simd dispatch          : " << name(row_scan_isa());
+  for(auto isa : {RowScanIsa::scalar, RowScanIsa::avx2, RowScanIsa::avx512}){
+    if(static_cast<int>(isa) > static_cast<int>(row_scan_isa())) continue;
+    now = kul::Now::NANOS();
+    for(size_t i = 0; i < SIZE * SIZE; i++) scan_row(d[i], SIZE, i, test, isa);
+    std::string label = std::string("time for simd ") + name(isa);
+    label.resize(23, ' ');
+    KLOG(INF) << label << ": " << (kul::Now::NANOS() - now);
+    KLOG(INF) << "found value            : " << (test) << (test == seq_test ? "" : " != seq");
+    KLOG(INF);
+    test = 0;
+  }
+
+  {
+    now = kul::Now::NANOS();
+    auto bits = OccupancyBitmap::of(&d[0][0], SIZE * SIZE, SIZE);
+    KLOG(INF) << "time for bitmap build  : " << (kul::Now::NANOS() - now);
+    now = kul::Now::NANOS();
+    for(size_t i = 0; i < SIZE * SIZE; i++) bitmap(i, bits, test);
+    KLOG(INF) << "time for bitmap        : " << (kul::Now::NANOS() - now);
+    KLOG(INF) << "found value            : " << (test) << (test == seq_test ? "" : " != seq");
+    KLOG(INF);
+    test = 0;
+  }
+
   {
     size_t n_threads = 8;
     size_t it = std::floor((SIZE * SIZE)/n_threads); // b = 16 | th = 2 | it = 8
@@ -176,5 +266,7 @@ int main(int argc, char* argv[]){
     KLOG(INF);
   }
   KLOG(INF) <<   "total                  : " << total;
+  KLOG(INF);
+  density_sweep();
   return 0;
 }
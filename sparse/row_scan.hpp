@@ -0,0 +1,103 @@
+#ifndef SPARSE_ROW_SCAN_HPP
+#define SPARSE_ROW_SCAN_HPP
+
+// seq() without a branch per double : test += i + j for the non zero d[i][j] of a dense row
+//  16 doubles per step are compared to zero 4 (AVX2) or 8 (AVX-512) at a time, the compares
+//  are packed into one 16 bit mask, a zero mask (most steps at the ~1/128 fill of cpp.cpp) is
+//  one well predicted branch, the set bits are visited with tzcnt
+//  the compare is not-equal unordered, so NaN counts like in `if(d[i][j])` and -0.0 does not
+// the kernels carry target attributes and are picked once at runtime with
+//  __builtin_cpu_supports (CPUID), the binary needs no -mavx2 and runs on any x86-64
+
+#include <cstddef>
+#include <cstdint>
+
+#include <immintrin.h>
+
+enum class RowScanIsa { scalar, avx2, avx512 };
+
+inline char const* name(RowScanIsa isa){
+  switch(isa){
+    case RowScanIsa::avx512: return "avx512";
+    case RowScanIsa::avx2: return "avx2";
+    default: return "scalar";
+  }
+}
+
+namespace row_scan_detail {
+
+constexpr std::size_t step = 16;
+
+inline std::size_t scalar(double const* row, std::size_t cols, std::size_t i, std::size_t j){
+  std::size_t test = 0;
+  for(; j < cols; j++) if(row[j]) test += i + j;
+  return test;
+}
+
+inline std::size_t visit(std::uint32_t mask, std::size_t i, std::size_t j){
+  std::size_t test = 0;
+  for(; mask; mask &= mask - 1) test += i + j + __builtin_ctz(mask);
+  return test;
+}
+
+// bit k set when row[j + k] != 0, lambdas do not inherit the target so these are functions
+__attribute__((target("avx2"))) inline std::uint32_t nonzero4(double const* row, std::size_t j){
+  auto const v = _mm256_loadu_pd(row + j);
+  return static_cast<std::uint32_t>(
+      _mm256_movemask_pd(_mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_NEQ_UQ)));
+}
+
+__attribute__((target("avx512f"))) inline std::uint32_t nonzero8(double const* row,
+                                                                  std::size_t j){
+  return _mm512_cmp_pd_mask(_mm512_loadu_pd(row + j), _mm512_setzero_pd(), _CMP_NEQ_UQ);
+}
+
+__attribute__((target("avx2"))) inline std::size_t avx2(double const* row, std::size_t cols,
+                                                         std::size_t i){
+  std::size_t test = 0, j = 0;
+  for(auto const body = cols - cols % step; j < body; j += step){
+    auto const mask = nonzero4(row, j) | nonzero4(row, j + 4) << 4 | nonzero4(row, j + 8) << 8
+                      | nonzero4(row, j + 12) << 12;
+    if(mask) test += visit(mask, i, j);
+  }
+  return test + scalar(row, cols, i, j);
+}
+
+__attribute__((target("avx512f"))) inline std::size_t avx512(double const* row, std::size_t cols,
+                                                              std::size_t i){
+  std::size_t test = 0, j = 0;
+  for(auto const body = cols - cols % step; j < body; j += step){
+    auto const mask = nonzero8(row, j) | nonzero8(row, j + 8) << 8;
+    if(mask) test += visit(mask, i, j);
+  }
+  return test + scalar(row, cols, i, j);
+}
+
+} // namespace row_scan_detail
+
+// the widest the cpu runs
+inline RowScanIsa row_scan_isa(){
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f")) return RowScanIsa::avx512;
+  if(__builtin_cpu_supports("avx2")) return RowScanIsa::avx2;
+  return RowScanIsa::scalar;
+}
+
+// test += i + j for the non zero row[j], j < cols, isa must be supported by the cpu
+inline void scan_row(double const* row, std::size_t cols, std::size_t i, std::size_t& test,
+                     RowScanIsa isa){
+  using namespace row_scan_detail;
+  switch(isa){
+    case RowScanIsa::avx512: test += avx512(row, cols, i); break;
+    case RowScanIsa::avx2: test += avx2(row, cols, i); break;
+    default: test += scalar(row, cols, i, 0);
+  }
+}
+
+// dispatched once on the first call
+inline void scan_row(double const* row, std::size_t cols, std::size_t i, std::size_t& test){
+  static RowScanIsa const isa = row_scan_isa();
+  scan_row(row, cols, i, test, isa);
+}
+
+#endif /* SPARSE_ROW_SCAN_HPP */
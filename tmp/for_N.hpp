@@ -0,0 +1,57 @@
+#include <tuple>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+
+template <typename T = std::uint16_t>
+struct Apply {
+    template <T i>
+    constexpr auto inline operator()() {
+        return std::integral_constant<T, i>{};
+    }
+};
+
+template <typename Apply, std::uint16_t... Is>
+constexpr auto inline apply_N(Apply& f, std::integer_sequence<std::uint16_t, Is...> const&) {
+    if constexpr (!std::is_same_v<decltype(f.template operator()<0>()), void>)
+        return std::make_tuple(f.template operator()<Is>()...);
+    (f.template operator()<Is>(), ...);
+}
+template <std::uint16_t N, typename Apply>
+constexpr auto inline apply_N(Apply&& f) {
+    return apply_N(f, std::make_integer_sequence<std::uint16_t, N>{});
+}
+
+template <std::uint16_t N, typename Fn>
+constexpr auto inline for_N(Fn& fn) {
+    using return_type =
+        std::decay_t<std::result_of_t<Fn(std::integral_constant<std::uint16_t, 0>)>>;
+    constexpr bool returns = !std::is_same_v<return_type, void>;
+
+    /*
+        for_N<2>([](auto ic) {
+            constexpr auto i = ic();
+            // ...
+        });
+    */
+    if constexpr (returns)
+        return std::apply([&](auto... ics) { return std::make_tuple(fn(ics)...); },
+                          apply_N<N>(Apply{}));
+    else
+        std::apply([&](auto... ics) { (fn(ics), ...); }, apply_N<N>(Apply{}));
+}
+
+template <std::uint16_t N, typename Fn>
+constexpr auto inline for_N(Fn&& fn) {
+    return for_N<N>(fn);
+}
+
+template <std::uint16_t N, typename Fn>
+constexpr auto inline for_N_all(Fn&& fn) {
+    return std::apply([&](auto const&... item) { return (item & ...); }, for_N<N>(fn));
+}
+
+template <std::uint16_t N, typename Fn>
+constexpr auto inline for_N_any(Fn&& fn) {
+    return std::apply([&](auto const&... item) { return (item | ...); }, for_N<N>(fn));
+}
@@ -0,0 +1,111 @@
+#include <cassert>
+#include <cstddef>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <iostream>
+
+
+template<typename T = std::vector<std::size_t>>
+struct iterator_impl
+{
+    using This  = iterator_impl<T>;
+    auto static constexpr is_const      = std::is_const_v<T>;
+
+    using value_type = std::decay_t<typename T::value_type>;
+    using difference_type   = std::ptrdiff_t;
+    using iterator_category = std::random_access_iterator_tag;
+    using pointer           = value_type*;
+    using reference         = value_type&;
+
+
+    iterator_impl() = default;
+    iterator_impl(T& particles_)
+        : particles{&particles_}
+    {
+    }
+
+    iterator_impl(iterator_impl&& that)      = default;
+    iterator_impl(iterator_impl const& that) = default;
+    iterator_impl& operator=(iterator_impl&& that) = default;
+    iterator_impl& operator=(iterator_impl const& that) = default;
+
+    auto& operator++()
+    {
+        ++curr_pos;
+        return *this;
+    }
+    auto operator++(int)
+    {
+        auto copy = *this;
+        ++curr_pos;
+        return copy;
+    }
+
+    auto& operator+=(difference_type i)
+    {
+        curr_pos += i;
+        return *this;
+    }
+    auto& operator-=(difference_type i)
+    {
+        curr_pos -= i;
+        return *this;
+    }
+
+    auto& operator--()
+    {
+        --curr_pos;
+        return *this;
+    }
+    auto operator--(int)
+    {
+        auto copy = *this;
+        --curr_pos;
+        return copy;
+    }
+    auto operator+(difference_type i) const
+    {
+        auto copy = *this;
+        copy.curr_pos += i;
+        return copy;
+    }
+    friend auto operator+(difference_type i, This const& that) { return that + i; }
+    auto operator-(difference_type i) const
+    {
+        auto copy = *this;
+        copy.curr_pos -= i;
+        return copy;
+    }
+
+
+
+    difference_type operator-(This const& that) const
+    {
+        return curr_pos - that.curr_pos;
+    }
+
+
+    auto operator==(iterator_impl const& that) const { return curr_pos == that.curr_pos; }
+    auto operator!=(iterator_impl const& that) const { return curr_pos != that.curr_pos; }
+    auto operator<(iterator_impl const& that) const { return curr_pos < that.curr_pos; }
+    auto operator>(iterator_impl const& that) const { return curr_pos > that.curr_pos; }
+    auto operator<=(iterator_impl const& that) const { return curr_pos <= that.curr_pos; }
+    auto operator>=(iterator_impl const& that) const { return curr_pos >= that.curr_pos; }
+
+    auto& operator*() { return (*particles)[curr_pos]; }
+    auto& operator*() const { return (*particles)[curr_pos]; }
+    auto& operator[](difference_type i) const { return (*particles)[curr_pos + i]; }
+
+    T* particles = nullptr; // a pointer so the iterator is default constructible and assignable
+    std::size_t curr_pos = 0;
+};
+
+template<typename V>
+auto _begin(V & v){
+    return iterator_impl<V>(v);
+}
+template<typename V>
+auto _end(V & v){
+    return iterator_impl<V>(v) + v.size();
+}
@@ -1,10 +1,12 @@
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <functional>
 #include <iostream>
 #include <chrono>
 #include <random>
 #include <thread>
+#include <utility>
 #include <vector>
 #include <iostream>
 #include <sstream>
@@ -100,6 +102,67 @@ bool static constexpr el_wise_less(V const& v0, V const& v1) {
     return v0.iCell < v1.iCell;
 }
 
+using Level = std::vector<Patch>;
+
+// flattened cell relative to the patch box, same order as el_wise_less
+auto cell_key(B const& box, P const& p) {
+    std::uint64_t key = 0;
+    for (std::size_t i = 0; i < 3; ++i)
+        key = key * (box.upper[i] - box.lower[i] + 1) + (p.iCell[i] - box.lower[i]);
+    return key;
+}
+
+// fn(thread, begin, end) over equal static chunks of [0, n)
+template <typename Fn>
+void parallel_for(std::uint16_t n_threads, std::size_t n, Fn&& fn) {
+    std::vector<std::thread> threads;
+    auto const chunk = (n + n_threads - 1) / n_threads;
+    for (std::uint16_t t = 0; t < n_threads; ++t)
+        threads.emplace_back([&, t]() {
+            auto const b = std::min(n, t * chunk);
+            fn(t, b, std::min(n, b + chunk));
+        });
+    for (auto& thread : threads) thread.join();
+}
+
+// LSD radix on the cell key, 8 bits per pass, only as many passes as the box needs
+//  each pass counts digits per thread chunk, then scatters each chunk to its own offsets
+void radix_sort(Patch& patch, std::uint16_t n_threads) {
+    n_threads = std::max<std::uint16_t>(1, n_threads);
+    constexpr std::uint16_t radix_bits = 8, buckets = 1 << radix_bits;
+    auto& particles = patch.particles;
+    auto const n = particles.size();
+
+    std::vector<std::uint64_t> keys(n), keys_tmp(n);
+    std::vector<P> particles_tmp(n);
+    parallel_for(n_threads, n, [&](auto, auto b, auto e) {
+        for (auto i = b; i < e; ++i) keys[i] = cell_key(patch.box, particles[i]);
+    });
+
+    std::uint16_t key_bits = 0;
+    while ((std::uint64_t{1} << key_bits) < patch.box.size()) ++key_bits;
+
+    std::vector<std::array<std::size_t, buckets>> offsets(n_threads);
+    for (std::uint16_t shift = 0; shift < key_bits; shift += radix_bits) {
+        parallel_for(n_threads, n, [&](auto t, auto b, auto e) {
+            offsets[t].fill(0);
+            for (auto i = b; i < e; ++i) ++offsets[t][(keys[i] >> shift) & (buckets - 1)];
+        });
+        std::size_t sum = 0;
+        for (std::size_t d = 0; d < buckets; ++d)
+            for (auto& offset : offsets) sum += std::exchange(offset[d], sum);
+        parallel_for(n_threads, n, [&](auto t, auto b, auto e) {
+            for (auto i = b; i < e; ++i) {
+                auto const o = offsets[t][(keys[i] >> shift) & (buckets - 1)]++;
+                keys_tmp[o] = keys[i];
+                particles_tmp[o] = particles[i];
+            }
+        });
+        std::swap(keys, keys_tmp);
+        std::swap(particles, particles_tmp);
+    }
+}
+
 namespace std {
 void sort(std::vector<P>& particles) {
     std::sort(particles.begin(), particles.end(), el_wise_less<P, 3>);
@@ -107,6 +170,62 @@ void sort(std::vector<P>& particles) {
 }
 void sort(Patch& patch) { std::sort(patch.particles); }
 
+// every patch of the level concurrently, per patch wall time in patch_ms
+//  patches big enough to keep one thread busy for the whole level are radix sorted by all
+//  threads, one after the other, the rest are grouped longest first into tasks that the
+//  threads pull until none are left
+void sort(Level& level, std::uint16_t n_threads, std::vector<double>& patch_ms) {
+    n_threads = std::max<std::uint16_t>(1, n_threads);
+    using clock = std::chrono::steady_clock;
+    auto const ms_since = [](auto const& start) {
+        return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    };
+
+    std::vector<Patch*> sorted_by_n_particles(level.size());
+    std::transform(level.begin(), level.end(), sorted_by_n_particles.begin(),
+                   [](auto& patch) { return &patch; });
+    std::sort(sorted_by_n_particles.begin(), sorted_by_n_particles.end(),
+              [](auto a, auto b) { return a->particles.size() > b->particles.size(); });
+
+    std::size_t total = 0;
+    for (auto const& patch : level) total += patch.particles.size();
+    patch_ms.resize(level.size());
+
+    auto it = sorted_by_n_particles.begin();
+    for (; it != sorted_by_n_particles.end() and (*it)->particles.size() * n_threads >= total;
+         ++it) {
+        auto const start = clock::now();
+        radix_sort(**it, n_threads);
+        patch_ms[*it - level.data()] = ms_since(start);
+        total -= (*it)->particles.size();
+    }
+
+    auto const grain = std::max<std::size_t>(1, total / (4 * n_threads));
+    std::vector<std::vector<Patch*>> tasks;
+    std::size_t task_size = grain;
+    for (; it != sorted_by_n_particles.end(); ++it) {
+        if (task_size >= grain) {
+            tasks.emplace_back();
+            task_size = 0;
+        }
+        tasks.back().push_back(*it);
+        task_size += (*it)->particles.size();
+    }
+
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> threads;
+    for (std::uint16_t t = 0; t < n_threads; ++t)
+        threads.emplace_back([&]() {
+            for (auto i = next++; i < tasks.size(); i = next++)
+                for (auto* patch : tasks[i]) {
+                    auto const start = clock::now();
+                    std::sort(*patch);
+                    patch_ms[patch - level.data()] = ms_since(start);
+                }
+        });
+    for (auto& thread : threads) thread.join();
+}
+
 }  // namespace std
 
 void f() {
@@ -117,4 +236,46 @@ void f() {
     p.print();
 }
 
-int main() { f(); }
\ No newline at end of file
+// skewed level, patch i holds max_particles / (i + 1)^2 particles
+int level_sort(std::size_t n_patches, std::size_t max_particles, std::uint16_t n_threads) {
+    using clock = std::chrono::steady_clock;
+    constexpr std::uint32_t cells = 32;
+
+    Level level;
+    for (std::uint32_t i = 0; i < n_patches; ++i) {
+        auto const n = std::max<std::size_t>(100, max_particles / ((i + 1) * (i + 1)));
+        level.emplace_back(B{{i * cells, 0, 0}, {(i + 1) * cells - 1, cells - 1, cells - 1}}, n);
+    }
+    auto expected = level;
+
+    auto start = clock::now();
+    for (auto& patch : expected) std::sort(patch);
+    auto const seq_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+    std::vector<double> patch_ms;
+    start = clock::now();
+    std::sort(level, n_threads, patch_ms);
+    auto const par_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+    bool ok = true;
+    for (std::size_t i = 0; i < level.size(); ++i) {
+        ok &= std::equal(level[i].particles.begin(), level[i].particles.end(),
+                         expected[i].particles.begin(),
+                         [](auto const& a, auto const& b) { return a.iCell == b.iCell; });
+        std::cout << "patch " << i << " particles " << level[i].particles.size() << " "
+                  << patch_ms[i] << " ms" << std::endl;
+    }
+    std::cout << "threads " << n_threads << std::endl;
+    std::cout << "sequential total " << seq_ms << " ms" << std::endl;
+    std::cout << "level total      " << par_ms << " ms" << std::endl;
+    std::cout << "matches sequential " << ok << std::endl;
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    f();
+    // hardware_concurrency() is 0 when it cannot tell
+    auto const n_threads = argc > 3 ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+    return level_sort(argc > 1 ? std::atoi(argv[1]) : 64, argc > 2 ? std::atoll(argv[2]) : 4e6,
+                      std::max(1u, static_cast<unsigned>(n_threads)));
+}
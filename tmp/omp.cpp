@@ -1,331 +1,264 @@
-#include <cstddef>
-#include <vector>
-#include <omp.h>
-#include <random>
-#include <string>
-#include <queue>
-#include <memory>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <future>
-#include <functional>
-#include <stdexcept>
-#include <iostream>
-#include <fstream>
-
-
-class Timer
-
-{
-public:
-    Timer(std::size_t& save, bool print = false)
-        : tstart_{std::chrono::high_resolution_clock::now()}
-        , save_{save}
-        , print_{print}
-    {
-    }
-
-    ~Timer()
-    {
-        tstop_ = std::chrono::high_resolution_clock::now();
-        std::size_t duration
-            = std::chrono::duration_cast<std::chrono::microseconds>(tstop_ - tstart_).count();
-        save_ = duration;
-        if (print_)
-            std::cout << duration << " us\n";
-    }
-
-private:
-    std::chrono::high_resolution_clock::time_point tstart_, tstop_;
-    std::size_t& save_;
-    bool print_;
-};
+#include "omp.hpp"
 
 
-
-
-template<std::size_t dim>
-struct Box
+// each particle deposits a total weight of 1, so the summed density is the particle count
+//  the fused interleaved deposit is checked against the separate fields, first order also
+//  checks the generic stencil and cell sorted kernels against the hand written one
+template<std::size_t dim, std::size_t order = 1>
+bool check_charge_conservation()
 {
-    Box(std::array<std::size_t, dim> lower_, std::array<std::size_t, dim> upper_)
-        : lower{lower_}
-        , upper{upper_}
+    std::array<std::size_t, dim> lower, upper;
+    for (std::size_t i = 0; i < dim; ++i)
     {
+        lower[i] = 3 + i;
+        upper[i] = 10 + 2 * i;
     }
-    std::array<std::size_t, dim> lower;
-    std::array<std::size_t, dim> upper;
-    auto size() const
+
+    bool ok = true;
+    for (auto ordered : {true, false})
     {
-        std::size_t s = 1;
-        for (std::size_t i = 0; i < dim; ++i)
+        ThreadBox<dim> box{lower, upper, Shape<order>::ghosts};
+        auto particles = ordered ? load_particles_ordered(box, 17) : load_particles_random(box, 17);
+        deposit<dim, order>(particles, box);
+
+        // the fluxes sum to the summed particle velocities
+        auto sum   = [](auto const& v) { return std::accumulate(std::begin(v), std::end(v), 0.); };
+        auto count = static_cast<double>(particles.icell_x.size());
+        std::array<double, 4> expected{count, sum(particles.v_x), sum(particles.v_y),
+                                       sum(particles.v_z)};
+        std::array<huge_vector<double> const*, 4> fields{&box.density, &box.fluxx, &box.fluxy,
+                                                         &box.fluxz};
+        for (std::size_t m = 0; m < 4; ++m)
+            ok &= std::abs(sum(*fields[m]) - expected[m]) < 1e-9 * count;
+
+        // fused interleaved deposit, read back through the per moment views
+        MomentBox<dim> moments{lower, upper, Shape<order>::ghosts};
+        deposit_moments<dim, order>(particles, moments);
+        auto const& cmoments = moments;
+        auto views = {density(cmoments), fluxx(cmoments), fluxy(cmoments), fluxz(cmoments)};
+        std::size_t m = 0;
+        for (auto const& view : views)
         {
-            s *= upper[i] - lower[i] + 1;
+            auto const& field = *fields[m++];
+            for (std::size_t i = 0; i < field.size(); ++i)
+                ok &= std::abs(view[i] - field[i]) < 1e-12;
         }
-        return s;
-    }
-    auto primal_size() const
-    {
-        std::size_t s = 1;
-        for (std::size_t i = 0; i < dim; ++i)
+
+        if constexpr (order == 1)
         {
-            s *= upper[i] - lower[i] + 1 + 1;
+            ThreadBox<dim> shaped{lower, upper}, sorted{lower, upper};
+            deposit_shaped<dim, 1>(particles, shaped);
+            deposit_sorted<dim>(particles, sorted);
+            for (std::size_t i = 0; i < box.density.size(); ++i)
+            {
+                ok &= std::abs(box.density[i] - shaped.density[i]) < 1e-12;
+                ok &= std::abs(box.fluxx[i] - shaped.fluxx[i]) < 1e-12;
+                ok &= std::abs(box.density[i] - sorted.density[i]) < 1e-9;
+                ok &= std::abs(box.fluxz[i] - sorted.fluxz[i]) < 1e-9;
+            }
         }
-        return s;
     }
-};
-template<std::size_t dim>
-struct ThreadBox : Box<dim>
-{
-    ThreadBox(std::array<std::size_t, dim> lower_, std::array<std::size_t, dim> upper_)
-        : Box<dim>(lower_, upper_)
-        , density(this->primal_size())
-        , fluxx(this->primal_size())
-        , fluxy(this->primal_size())
-        , fluxz(this->primal_size())
-    {
-    }
-    std::vector<double> density;
-    std::vector<double> fluxx;
-    std::vector<double> fluxy;
-    std::vector<double> fluxz;
-};
+    std::cout << dim << "D order " << order << " charge conservation : " << (ok ? "ok" : "FAILED")
+              << "\n";
+    return ok;
+}
 
+// Philox known answers (Random123 kat_vectors), and the parallel loaders give the same bits
+//  with one thread as with all of them
 template<std::size_t dim>
-struct ParticleArray
-{
-};
-
-template<>
-struct ParticleArray<1>
+bool check_parallel_loader()
 {
-    explicit ParticleArray(std::size_t nbparts)
-        : icell_x(nbparts)
-        , delta_x(nbparts)
-    {
-    }
-    std::vector<int> icell_x;
-    std::vector<double> delta_x;
-};
-
-
-template<>
-struct ParticleArray<2>
-{
-    explicit ParticleArray(std::size_t nbparts)
-        : icell_x(nbparts)
-        , icell_y(nbparts)
-        , delta_x(nbparts)
-        , delta_y(nbparts)
-    {
-    }
-    std::vector<int> icell_x;
-    std::vector<int> icell_y;
-    std::vector<double> delta_x;
-    std::vector<double> delta_y;
-};
+    auto kat = [](Philox4x32::counter_t c, Philox4x32::key_t k, Philox4x32::counter_t expected) {
+        return Philox4x32::generate(c, k) == expected;
+    };
+    bool ok = kat({0, 0, 0, 0}, {0, 0}, {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8})
+              and kat({~0u, ~0u, ~0u, ~0u}, {~0u, ~0u},
+                      {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd})
+              and kat({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0},
+                      {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+
+    std::array<std::size_t, dim> lower{}, upper;
+    upper.fill(7);
+    auto boxes = make_threadboxes<dim>(16, 8);
+
+    auto const maxthreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    auto ordered = load_particles_ordered_parallel(Box<dim>{lower, upper}, 13, 7);
+    auto random  = load_threadbox_particles<dim>(boxes, 13, false);
+    omp_set_num_threads(maxthreads);
+
+    auto same = [](ParticleArray<dim> const& a, ParticleArray<dim> const& b) {
+        bool same_bits = a.icell_x == b.icell_x and a.delta_x == b.delta_x and a.v_x == b.v_x
+                         and a.v_y == b.v_y and a.v_z == b.v_z;
+        if constexpr (dim >= 2)
+            same_bits = same_bits and a.icell_y == b.icell_y and a.delta_y == b.delta_y;
+        if constexpr (dim == 3)
+            same_bits = same_bits and a.icell_z == b.icell_z and a.delta_z == b.delta_z;
+        return same_bits;
+    };
+    ok &= same(ordered, load_particles_ordered_parallel(Box<dim>{lower, upper}, 13, 7));
+    auto random_all = load_threadbox_particles<dim>(boxes, 13, false);
+    for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+        ok &= same(random[ibox], random_all[ibox]);
+
+    // same cells as the serial loader, deltas in [0, 1)
+    auto serial = load_particles_ordered(Box<dim>{lower, upper}, 13);
+    ok &= serial.icell_x == ordered.icell_x;
+    for (auto d : ordered.delta_x)
+        ok &= d >= 0 and d < 1;
+
+    std::cout << dim << "D parallel loader : " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
 
-template<>
-struct ParticleArray<3>
+// float particles or fields against the all double deposit, float rounding is ~6e-8 so a few
+//  hundred particles per node stay well below the bounds
+template<std::size_t dim, std::size_t order>
+bool check_mixed_precision()
 {
-    explicit ParticleArray(std::size_t nbparts)
-        : icell_x(nbparts)
-        , icell_y(nbparts)
-        , icell_z(nbparts)
-        , delta_x(nbparts)
-        , delta_y(nbparts)
-        , delta_z(nbparts)
+    std::array<std::size_t, dim> lower, upper;
+    for (std::size_t i = 0; i < dim; ++i)
     {
+        lower[i] = 2;
+        upper[i] = 9;
     }
-    std::vector<int> icell_x;
-    std::vector<int> icell_y;
-    std::vector<int> icell_z;
-    std::vector<double> delta_x;
-    std::vector<double> delta_y;
-    std::vector<double> delta_z;
-};
-
-
+    auto constexpr ghosts = Shape<order>::ghosts;
+    auto particles        = load_particles_random(Box<dim>{lower, upper}, 50);
+    auto fparticles       = with_precision<float>(particles);
+
+    ThreadBox<dim> reference{lower, upper, ghosts}, float_particles{lower, upper, ghosts};
+    ThreadBox<dim, float> float_fields{lower, upper, ghosts}, all_float{lower, upper, ghosts};
+    deposit<dim, order>(particles, reference);
+    deposit<dim, order>(fparticles, float_particles);
+    deposit<dim, order>(particles, float_fields);
+    deposit<dim, order>(fparticles, all_float);
+
+    bool ok = max_deviation(float_particles, reference) < 1e-5
+              and max_deviation(float_fields, reference) < 1e-4
+              and max_deviation(all_float, reference) < 1e-4;
+    std::cout << dim << "D order " << order << " mixed precision : " << (ok ? "ok" : "FAILED")
+              << "\n";
+    return ok;
+}
 
+// tiled fields against the flat deposit, on a box whose node count is not a multiple of the
+//  tile edge so the padded edge tiles are exercised, with particles in tile order
 template<std::size_t dim>
-auto load_particles_random(Box<dim> const& box, std::size_t nppc)
+bool check_tiled()
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> distx(box.lower[0], box.upper[0]);
-    std::uniform_int_distribution<> distdelta(0, 1);
-    ParticleArray<dim> particles(nppc * box.size());
-    for (std::size_t ip = 0; ip < particles.icell_x.size(); ++ip)
-    {
-        particles.icell_x[ip] = distx(gen);
-        particles.delta_x[ip] = distdelta(gen);
-    }
-    if constexpr (dim >= 2)
-    {
-        std::uniform_int_distribution<int> disty(box.lower[1], box.upper[1]);
-        for (std::size_t ip = 0; ip < particles.icell_x.size(); ++ip)
-        {
-            particles.icell_y[ip] = disty(gen);
-            particles.delta_y[ip] = distdelta(gen);
-        }
-    }
-    if constexpr (dim == 3)
+    std::array<std::size_t, dim> lower, upper;
+    for (std::size_t i = 0; i < dim; ++i)
     {
-        std::uniform_int_distribution<int> distz(box.lower[2], box.upper[2]);
-        for (std::size_t ip = 0; ip < particles.icell_x.size(); ++ip)
-        {
-            particles.icell_z[ip] = distz(gen);
-            particles.delta_z[ip] = distdelta(gen);
-        }
+        lower[i] = 3;
+        upper[i] = 13; // 12 nodes
     }
-    return particles;
+    auto particles = load_particles_random(Box<dim>{lower, upper}, 20);
+    TiledBox<dim> tiled{lower, upper};
+    ThreadBox<dim> expected{lower, upper}, flat{lower, upper};
+
+    deposit<dim>(particles, expected);
+    order_by_tile(particles, tiled);
+    deposit_tiled(particles, tiled);
+    copy_to(tiled, flat);
+
+    bool ok = max_deviation(flat, expected) < 1e-12;
+    std::cout << dim << "D tiled fields : " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
 }
 
-template<std::size_t dim>
-auto load_particles_ordered(Box<dim> const& box, std::size_t nppc)
+// linear fields are reproduced exactly by first and second order shapes : every component
+//  set to a + b . x on the nodes must come back as a + b . (icell + delta) on the sorted
+//  and the unsorted path
+template<std::size_t dim, std::size_t order>
+bool check_interpolation()
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<double> distdelta(0, 1);
-    ParticleArray<dim> particles(nppc * box.size());
-    std::size_t pidx = 0;
-    if constexpr (dim == 1)
+    std::array<std::size_t, dim> lower, upper;
+    for (std::size_t i = 0; i < dim; ++i)
     {
-        for (std::size_t i = box.lower[0]; i <= box.upper[0]; ++i)
-        {
-            for (std::size_t ip = 0; ip < nppc; ++ip)
-            {
-                particles.icell_x[pidx]   = i;
-                particles.delta_x[pidx++] = distdelta(gen);
-            }
-        }
-        return particles;
+        lower[i] = 3;
+        upper[i] = 13;
     }
-    else if constexpr (dim == 2)
+    EMBox<dim> fields{lower, upper, Shape<order>::ghosts};
+    auto linear = [](std::size_t m, auto const& x) {
+        double value = m;
+        for (std::size_t d = 0; d < dim; ++d)
+            value += (m + 1.) * (d + 1.) * x[d];
+        return value;
+    };
+    auto const shape = fields.field_shape();
+    auto components  = fields.components();
+    for (std::size_t idx = 0; idx < fields.field_size(); ++idx)
     {
-        for (std::size_t i = box.lower[0]; i <= box.upper[0]; ++i)
-        {
-            for (std::size_t j = box.lower[1]; j <= box.upper[1]; ++j)
-            {
-                for (std::size_t ip = 0; ip < nppc; ++ip)
-                {
-                    particles.icell_x[pidx]   = i;
-                    particles.icell_y[pidx]   = j;
-                    particles.delta_x[pidx]   = distdelta(gen);
-                    particles.delta_y[pidx++] = distdelta(gen);
-                }
-            }
-        }
-        return particles;
+        std::array<double, dim> x;
+        for (std::size_t d = dim, rest = idx; d-- > 0; rest /= shape[d])
+            x[d] = static_cast<double>(lower[d] + rest % shape[d]) - fields.ghosts;
+        for (std::size_t m = 0; m < 6; ++m)
+            (*components[m])[idx] = linear(m, x);
     }
-    else if constexpr (dim == 3)
-    {
-        for (std::size_t i = box.lower[0]; i <= box.upper[0]; ++i)
+
+    auto check = [&](auto const& particles, auto&& interpolate) {
+        ParticleEM em{particles.icell_x.size()};
+        interpolate(particles, em);
+        auto const out = em.components();
+        double diff    = 0;
+        for (std::size_t ip = 0; ip < particles.icell_x.size(); ++ip)
         {
-            for (std::size_t j = box.lower[1]; j <= box.upper[1]; ++j)
-            {
-                for (std::size_t k = box.lower[2]; k <= box.upper[2]; ++k)
-                {
-                    for (std::size_t ip = 0; ip < nppc; ++ip)
-                    {
-                        particles.icell_x[pidx]   = i;
-                        particles.icell_y[pidx]   = j;
-                        particles.icell_z[pidx]   = k;
-                        particles.delta_x[pidx]   = distdelta(gen);
-                        particles.delta_y[pidx]   = distdelta(gen);
-                        particles.delta_z[pidx++] = distdelta(gen);
-                    }
-                }
-            }
+            std::array<double, dim> x;
+            for_N<dim>([&](auto ic) {
+                constexpr auto d = ic();
+                x[d]             = icell<d>(particles)[ip] + delta<d>(particles)[ip];
+            });
+            for (std::size_t m = 0; m < 6; ++m)
+                diff = std::max(diff, std::abs((*out[m])[ip] - linear(m, x)));
         }
-        return particles;
-    }
+        return diff < 1e-10;
+    };
+    Box<dim> box{lower, upper};
+    auto sorted   = load_particles_ordered(box, 20);
+    auto unsorted = load_particles_random(box, 20);
+
+    bool ok = check(sorted, [&](auto const& particles, auto& em) {
+        interpolate_sorted<dim, order>(particles, fields, em);
+    });
+    ok = ok and check(unsorted, [&](auto const& particles, auto& em) {
+             interpolate_unsorted<dim, order>(particles, fields, em);
+         });
+    ok = ok and check(unsorted, [&](auto const& particles, auto& em) {
+             interpolate<dim, order>(particles, fields, em);
+         });
+    std::cout << dim << "D order " << order << " interpolation : " << (ok ? "ok" : "FAILED")
+              << "\n";
+    return ok;
 }
 
 template<std::size_t dim>
-void deposit(ParticleArray<dim> const& particles, ThreadBox<dim>& threadbox)
+bool check_charge_conservation_all_orders()
 {
-    if constexpr (dim == 1)
-        for (std::size_t ip = 0; ip < particles.icell_x.size(); ++ip)
-        {
-            auto dx = particles.delta_x[ip];
-            auto ix = particles.icell_x[ip];
-            auto nx = threadbox.upper[0] - threadbox.loxer[0] + 1;
-
-            auto w1 = (1.0 - dx);
-            auto w2 = (dx);
-
-            auto ix1 = ix;
-            auto ix2 = ix + 1;
-
-            threadbox.density[ix1] += w1;
-            threadbox.density[ix2] += w2;
-        }
-    if constexpr (dim == 2)
-    {
-        for (std::size_t ip = 0; ip < particles.icell_x.size(); ++ip)
-        {
-            auto dx = particles.delta_x[ip];
-            auto dy = particles.delta_y[ip];
-            auto ix = particles.icell_x[ip] - threadbox.lower[0];
-            auto iy = particles.icell_y[ip] - threadbox.lower[1];
-            auto nx = threadbox.upper[0] - threadbox.lower[0] + 2;
-            auto ny = threadbox.upper[1] - threadbox.lower[1] + 2;
-
-            auto w1 = (1.0 - dx) * (1.0 - dy);
-            auto w2 = (1.0 - dx) * (dy);
-            auto w3 = (dx) * (dy);
-            auto w4 = (dx) * (1.0 - dy);
-
-            auto ixy1 = iy + (ix)*ny;
-            auto ixy2 = iy + 1 + (ix)*ny;
-            auto ixy3 = iy + 1 + (ix + 1) * ny;
-            auto ixy4 = iy + (ix + 1) * ny;
-
-            threadbox.density[ixy1] += w1;
-            threadbox.density[ixy2] += w2;
-            threadbox.density[ixy3] += w3;
-            threadbox.density[ixy4] += w4;
-
-            threadbox.fluxx[ixy1] += w1;
-            threadbox.fluxx[ixy2] += w2;
-            threadbox.fluxx[ixy3] += w3;
-            threadbox.fluxx[ixy4] += w4;
-
-            threadbox.fluxy[ixy1] += w1;
-            threadbox.fluxy[ixy2] += w2;
-            threadbox.fluxy[ixy3] += w3;
-            threadbox.fluxy[ixy4] += w4;
-
-            threadbox.fluxz[ixy1] += w1;
-            threadbox.fluxz[ixy2] += w2;
-            threadbox.fluxz[ixy3] += w3;
-            threadbox.fluxz[ixy4] += w4;
-        }
-    }
+    return check_charge_conservation<dim, 1>() and check_charge_conservation<dim, 2>()
+           and check_charge_conservation<dim, 3>();
 }
 
 
-int main(int argc, char** argv)
+template<std::size_t dim>
+int run(std::size_t N, std::size_t TB, std::size_t nppc)
 {
-    std::size_t N         = std::atoi(argv[1]);
-    std::size_t TB        = std::atoi(argv[2]);
-    std::size_t step      = TB;
-    std::size_t LASTSTART = N;
-    std::cout << N << "x" << N << "domain\n";
-    std::cout << TB << "x" << TB << " threadboxes\n";
+    std::cout << N << "^" << dim << " domain\n";
+    std::cout << TB << "^" << dim << " threadboxes\n";
+    std::cout << nppc << " particles per cell\n";
     double tseq;
     double tpar;
     constexpr std::size_t repeat = 1000;
     std::vector<double> times(repeat);
+    std::array<std::size_t, dim> domain_lower{}, domain_upper;
+    domain_upper.fill(N);
     for (std::size_t r = 0; r < repeat; ++r)
     {
-        ThreadBox<2> domain{{0, 0}, {N, N}};
-        auto particles = load_particles_ordered(domain, 10000);
+        ThreadBox<dim> domain{domain_lower, domain_upper};
+        auto particles = load_particles_ordered_parallel(domain, nppc, 0);
         // Timer time(times[r]);
         auto start = omp_get_wtime();
         {
-            deposit<2>(particles, domain);
+            deposit<dim>(particles, domain);
         }
         times[r] = omp_get_wtime() - start;
     }
@@ -334,19 +267,8 @@ int main(int argc, char** argv)
     std::cout << "sequential time : " << tseq << "\n";
 
 
-    std::vector<ThreadBox<2>> boxes;
-    std::vector<ParticleArray<2>> particles;
-    for (std::size_t istart = 0; istart < LASTSTART; istart += step)
-    {
-        for (std::size_t jstart = 0; jstart < LASTSTART; jstart += step)
-        {
-            auto box = ThreadBox<2>{{istart, jstart}, {istart + TB - 1, jstart + TB - 1}};
-            // std::cout << istart << "," << jstart << "-->" << istart + TB - 1 << ","
-            //        << jstart + TB - 1 << "\n";
-            boxes.push_back(box);
-            particles.push_back(load_particles_ordered(box, 10000));
-        }
-    }
+    auto boxes     = make_threadboxes<dim>(N, TB);
+    auto particles = load_threadbox_particles<dim>(boxes, nppc);
     std::cout << "there are " << boxes.size() << " threadboxes\n";
     std::cout << "there are " << particles.size() << " particle arrays\n";
 
@@ -367,7 +289,7 @@ int main(int argc, char** argv)
 #pragma omp for
                 for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
                 {
-                    deposit<2>(particles[ibox], boxes[ibox]);
+                    deposit<dim>(particles[ibox], boxes[ibox]);
                 }
             }
             times[r] = omp_get_wtime() - start;
@@ -380,7 +302,9 @@ int main(int argc, char** argv)
         // std::cout << "speedup : " << su << '\n';
     }
 
-    std::ofstream of{"speedup_" + std::to_string(N) + "_" + std::to_string(TB) + ".txt"};
+    // 2D keeps the name py.py globs for
+    std::string prefix = dim == 2 ? "speedup_" : "speedup" + std::to_string(dim) + "d_";
+    std::ofstream of{prefix + std::to_string(N) + "_" + std::to_string(TB) + ".txt"};
     for (std::size_t ithread = 0; ithread < nthreads.size(); ++ithread)
     {
         of << nthreads[ithread] << " " << speedup[ithread] << "\n";
@@ -389,3 +313,203 @@ int main(int argc, char** argv)
     return 0;
 }
 
+
+
+// machine baselines for the roofline, per thread count
+
+// STREAM triad a = b + s * c, best of repeat, 24 bytes per element as STREAM counts them
+double stream_triad_gbs(int nthreads, std::size_t n = std::size_t{1} << 25,
+                        std::size_t repeat = 10)
+{
+    std::unique_ptr<double[]> a{new double[n]}, b{new double[n]}, c{new double[n]};
+#pragma omp parallel for schedule(static) num_threads(nthreads) // first touch
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        a[i] = 0;
+        b[i] = 1;
+        c[i] = 2;
+    }
+    double best = std::numeric_limits<double>::max();
+    for (std::size_t r = 0; r < repeat; ++r)
+    {
+        auto start = omp_get_wtime();
+#pragma omp parallel for simd schedule(static) num_threads(nthreads)
+        for (std::size_t i = 0; i < n; ++i)
+            a[i] = b[i] + 3. * c[i];
+        best = std::min(best, omp_get_wtime() - start);
+    }
+    return 3 * sizeof(double) * n / best * 1e-9;
+}
+
+// multiply-add throughput, 32 independent accumulators per thread keep the pipelines full
+double peak_gflops(int nthreads, std::size_t iterations = std::size_t{1} << 24)
+{
+    constexpr std::size_t lanes = 32;
+    double sink                 = 0;
+    auto start                  = omp_get_wtime();
+#pragma omp parallel num_threads(nthreads) reduction(+ : sink)
+    {
+        double x[lanes];
+        for (std::size_t l = 0; l < lanes; ++l)
+            x[l] = 1. + l * 1e-3 + omp_get_thread_num();
+        for (std::size_t it = 0; it < iterations; ++it)
+        {
+#pragma omp simd
+            for (std::size_t l = 0; l < lanes; ++l)
+                x[l] = x[l] * 0.9999999 + 1e-7;
+        }
+        for (std::size_t l = 0; l < lanes; ++l)
+            sink += x[l];
+    }
+    auto t = omp_get_wtime() - start;
+    if (sink == 0) // never, keeps the loop alive
+        std::cout << sink;
+    return 2. * lanes * iterations * nthreads / t * 1e-9;
+}
+
+
+struct Baseline
+{
+    double stream_gbs, peak_gflops;
+};
+
+// time of one parallel deposit over all boxes, mean of repeat
+template<typename Boxes, typename Deposit>
+double time_parallel_deposit(Boxes& boxes, Deposit&& deposit, std::size_t repeat)
+{
+    std::vector<double> times(repeat);
+    for (std::size_t r = 0; r < repeat; ++r)
+    {
+        auto start = omp_get_wtime();
+#pragma omp parallel for
+        for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+            deposit(ibox);
+        times[r] = omp_get_wtime() - start;
+    }
+    return std::accumulate(std::begin(times), std::end(times), 0.) / repeat;
+}
+
+// one csv line per kernel and thread count, bytes and flops from the model next to the kernels
+//  (particle_bytes, field_bytes, deposit_flops), pct_roofline is GFLOP/s over
+//  min(peak, intensity * stream)
+template<std::size_t dim, std::size_t order, bool fused = false>
+void roofline_kernel(std::size_t N, std::size_t TB, std::size_t nppc, std::size_t repeat,
+                     std::vector<Baseline> const& baselines, std::ostream& csv)
+{
+    constexpr auto ghosts = Shape<order>::ghosts;
+    using Box_t           = std::conditional_t<fused, MomentBox<dim>, ThreadBox<dim>>;
+
+    std::vector<Box_t> boxes;
+    for (auto const& box : make_threadboxes<dim>(N, TB, ghosts))
+        boxes.emplace_back(box.lower, box.upper, ghosts);
+    auto particles = load_threadbox_particles<dim>(boxes, nppc);
+
+    double bytes = 0, nparticles = 0;
+    for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+    {
+        nparticles += particles[ibox].icell_x.size();
+        bytes += particles[ibox].icell_x.size() * particle_bytes<dim> + field_bytes(boxes[ibox]);
+    }
+    double const flops = deposit_flops<dim, order>() * nparticles;
+
+    for (std::size_t ithread = 0; ithread < baselines.size(); ++ithread)
+    {
+        auto nthreads = static_cast<int>(ithread) + 1;
+        omp_set_num_threads(nthreads);
+        auto t = time_parallel_deposit(
+            boxes,
+            [&](std::size_t ibox) {
+                if constexpr (fused)
+                    deposit_moments<dim, order>(particles[ibox], boxes[ibox]);
+                else
+                    deposit<dim, order>(particles[ibox], boxes[ibox]);
+            },
+            repeat);
+
+        auto const& base = baselines[ithread];
+        auto gbs         = bytes / t * 1e-9;
+        auto gflops      = flops / t * 1e-9;
+        auto attainable  = std::min(base.peak_gflops, flops / bytes * base.stream_gbs);
+        csv << dim << "," << (fused ? "deposit_moments" : "deposit") << "," << order << ","
+            << nthreads << "," << t / nparticles * 1e9 << "," << bytes / nparticles << ","
+            << flops / nparticles << "," << flops / bytes << "," << gbs << "," << gflops << ","
+            << base.stream_gbs << "," << base.peak_gflops << "," << 100 * gbs / base.stream_gbs
+            << "," << 100 * gflops / base.peak_gflops << "," << 100 * gflops / attainable
+            << "\n";
+    }
+}
+
+// roofline<dim>d_N_TB.csv, also on stdout
+//  run<dim> leaves the thread count changed, so maxthreads comes from main
+template<std::size_t dim>
+void roofline(std::size_t N, std::size_t TB, std::size_t nppc, std::size_t repeat,
+              int maxthreads)
+{
+    std::vector<Baseline> baselines;
+    for (int nthreads = 1; nthreads <= maxthreads; ++nthreads)
+        baselines.push_back({stream_triad_gbs(nthreads), peak_gflops(nthreads)});
+
+    std::ostringstream csv;
+    csv << "dim,kernel,order,threads,ns_per_particle,bytes_per_particle,flops_per_particle,"
+           "flops_per_byte,GB_per_s,GFLOP_per_s,stream_GB_per_s,peak_GFLOP_per_s,pct_stream,"
+           "pct_peak_flops,pct_roofline\n";
+    roofline_kernel<dim, 1>(N, TB, nppc, repeat, baselines, csv);
+    roofline_kernel<dim, 2>(N, TB, nppc, repeat, baselines, csv);
+    roofline_kernel<dim, 3>(N, TB, nppc, repeat, baselines, csv);
+    roofline_kernel<dim, 1, /*fused=*/true>(N, TB, nppc, repeat, baselines, csv);
+    omp_set_num_threads(maxthreads);
+
+    std::cout << csv.str();
+    std::ofstream{"roofline" + std::to_string(dim) + "d_" + std::to_string(N) + "_"
+                  + std::to_string(TB) + ".csv"}
+        << csv.str();
+}
+
+
+// omp N TB [dim=2] [nppc=10000] [roofline_repeat=10]
+//  dim 0 runs 1D, 2D and 3D, roofline_repeat 0 skips the roofline
+int main(int argc, char** argv)
+{
+    std::size_t N               = std::atoi(argv[1]);
+    std::size_t TB              = std::atoi(argv[2]);
+    std::size_t dim             = argc > 3 ? std::atoi(argv[3]) : 2;
+    std::size_t nppc            = argc > 4 ? std::atoi(argv[4]) : 10000;
+    std::size_t roofline_repeat = argc > 5 ? std::atoi(argv[5]) : 10;
+    int const maxthreads        = omp_get_max_threads(); // OMP_NUM_THREADS or the core count
+
+    if (!check_charge_conservation_all_orders<1>() or !check_charge_conservation_all_orders<2>()
+        or !check_charge_conservation_all_orders<3>())
+        return 1;
+    if (!check_parallel_loader<1>() or !check_parallel_loader<2>() or !check_parallel_loader<3>())
+        return 1;
+    if (!check_mixed_precision<1, 1>() or !check_mixed_precision<2, 1>()
+        or !check_mixed_precision<3, 1>() or !check_mixed_precision<2, 3>())
+        return 1;
+    if (!check_tiled<1>() or !check_tiled<2>() or !check_tiled<3>())
+        return 1;
+    if (!check_interpolation<1, 1>() or !check_interpolation<2, 1>()
+        or !check_interpolation<3, 1>() or !check_interpolation<1, 2>()
+        or !check_interpolation<2, 2>() or !check_interpolation<3, 2>())
+        return 1;
+
+    for (std::size_t d : {1, 2, 3})
+    {
+        if (dim != 0 and dim != d)
+            continue;
+        if (d == 1)
+            run<1>(N, TB, nppc);
+        if (d == 2)
+            run<2>(N, TB, nppc);
+        if (d == 3)
+            run<3>(N, TB, nppc);
+        if (roofline_repeat == 0)
+            continue;
+        if (d == 1)
+            roofline<1>(N, TB, nppc, roofline_repeat, maxthreads);
+        if (d == 2)
+            roofline<2>(N, TB, nppc, roofline_repeat, maxthreads);
+        if (d == 3)
+            roofline<3>(N, TB, nppc, roofline_repeat, maxthreads);
+    }
+    return 0;
+}
@@ -0,0 +1,1837 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+#include <omp.h>
+#include <random>
+#include <string>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+
+#include "for_N.hpp"
+#include "philox.hpp"
+#include "../prefetch/gather.hpp"
+#include "../prefetch/huge_pages.hpp"
+
+
+// particle and field storage : 2MB / 1GB pages once an array reaches 2MB, see huge_pages.hpp
+template<typename T>
+using huge_vector = std::vector<T, HugePageAllocator<T>>;
+
+
+class Timer
+
+{
+public:
+    Timer(std::size_t& save, bool print = false)
+        : tstart_{std::chrono::high_resolution_clock::now()}
+        , save_{save}
+        , print_{print}
+    {
+    }
+
+    ~Timer()
+    {
+        tstop_ = std::chrono::high_resolution_clock::now();
+        std::size_t duration
+            = std::chrono::duration_cast<std::chrono::microseconds>(tstop_ - tstart_).count();
+        save_ = duration;
+        if (print_)
+            std::cout << duration << " us\n";
+    }
+
+private:
+    std::chrono::high_resolution_clock::time_point tstart_, tstop_;
+    std::size_t& save_;
+    bool print_;
+};
+
+
+
+
+template<std::size_t dim>
+struct Box
+{
+    Box(std::array<std::size_t, dim> lower_, std::array<std::size_t, dim> upper_)
+        : lower{lower_}
+        , upper{upper_}
+    {
+    }
+    std::array<std::size_t, dim> lower;
+    std::array<std::size_t, dim> upper;
+    auto size() const
+    {
+        std::size_t s = 1;
+        for (std::size_t i = 0; i < dim; ++i)
+        {
+            s *= upper[i] - lower[i] + 1;
+        }
+        return s;
+    }
+    auto primal_size() const
+    {
+        std::size_t s = 1;
+        for (std::size_t i = 0; i < dim; ++i)
+        {
+            s *= upper[i] - lower[i] + 1 + 1;
+        }
+        return s;
+    }
+};
+// Acc : precision the fields accumulate in
+template<std::size_t dim, typename Acc = double>
+struct ThreadBox : Box<dim>
+{
+    // ghosts : extra nodes on each side, for shapes that reach outside the primal nodes
+    ThreadBox(std::array<std::size_t, dim> lower_, std::array<std::size_t, dim> upper_,
+              std::size_t ghosts_ = 0)
+        : Box<dim>(lower_, upper_)
+        , ghosts{ghosts_}
+        , density(field_size())
+        , fluxx(field_size())
+        , fluxy(field_size())
+        , fluxz(field_size())
+    {
+    }
+    auto field_shape() const
+    {
+        std::array<std::size_t, dim> shape;
+        for (std::size_t i = 0; i < dim; ++i)
+            shape[i] = this->upper[i] - this->lower[i] + 2 + 2 * ghosts;
+        return shape;
+    }
+    auto field_size() const
+    {
+        auto shape = field_shape();
+        return std::accumulate(std::begin(shape), std::end(shape), std::size_t{1},
+                               std::multiplies<std::size_t>());
+    }
+    std::size_t ghosts;
+    huge_vector<Acc> density;
+    huge_vector<Acc> fluxx;
+    huge_vector<Acc> fluxy;
+    huge_vector<Acc> fluxz;
+};
+
+// Real : storage precision of the deltas and velocities
+template<std::size_t dim, typename Real = double>
+struct ParticleArray
+{
+};
+
+template<typename Real>
+struct ParticleArray<1, Real>
+{
+    using real_t = Real;
+
+    explicit ParticleArray(std::size_t nbparts)
+        : icell_x(nbparts)
+        , delta_x(nbparts)
+        , v_x(nbparts)
+        , v_y(nbparts)
+        , v_z(nbparts)
+    {
+    }
+    huge_vector<int> icell_x;
+    huge_vector<Real> delta_x;
+    huge_vector<Real> v_x; // all three velocity components whatever the dimension
+    huge_vector<Real> v_y;
+    huge_vector<Real> v_z;
+};
+
+
+template<typename Real>
+struct ParticleArray<2, Real>
+{
+    using real_t = Real;
+
+    explicit ParticleArray(std::size_t nbparts)
+        : icell_x(nbparts)
+        , icell_y(nbparts)
+        , delta_x(nbparts)
+        , delta_y(nbparts)
+        , v_x(nbparts)
+        , v_y(nbparts)
+        , v_z(nbparts)
+    {
+    }
+    huge_vector<int> icell_x;
+    huge_vector<int> icell_y;
+    huge_vector<Real> delta_x;
+    huge_vector<Real> delta_y;
+    huge_vector<Real> v_x;
+    huge_vector<Real> v_y;
+    huge_vector<Real> v_z;
+};
+
+template<typename Real>
+struct ParticleArray<3, Real>
+{
+    using real_t = Real;
+
+    explicit ParticleArray(std::size_t nbparts)
+        : icell_x(nbparts)
+        , icell_y(nbparts)
+        , icell_z(nbparts)
+        , delta_x(nbparts)
+        , delta_y(nbparts)
+        , delta_z(nbparts)
+        , v_x(nbparts)
+        , v_y(nbparts)
+        , v_z(nbparts)
+    {
+    }
+    huge_vector<int> icell_x;
+    huge_vector<int> icell_y;
+    huge_vector<int> icell_z;
+    huge_vector<Real> delta_x;
+    huge_vector<Real> delta_y;
+    huge_vector<Real> delta_z;
+    huge_vector<Real> v_x;
+    huge_vector<Real> v_y;
+    huge_vector<Real> v_z;
+};
+
+
+
+// thermal velocities
+template<std::size_t dim, typename Gen>
+void load_velocities(ParticleArray<dim>& particles, Gen& gen)
+{
+    std::normal_distribution<double> distv(0, 1);
+    for (auto* v : {&particles.v_x, &particles.v_y, &particles.v_z})
+        for (auto& vi : *v)
+            vi = distv(gen);
+}
+
+template<std::size_t dim>
+auto load_particles_random(Box<dim> const& box, std::size_t nppc)
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<int> distx(box.lower[0], box.upper[0]);
+    std::uniform_real_distribution<double> distdelta(0, 1);
+    ParticleArray<dim> particles(nppc * box.size());
+    for (std::size_t ip = 0; ip < particles.icell_x.size(); ++ip)
+    {
+        particles.icell_x[ip] = distx(gen);
+        particles.delta_x[ip] = distdelta(gen);
+    }
+    if constexpr (dim >= 2)
+    {
+        std::uniform_int_distribution<int> disty(box.lower[1], box.upper[1]);
+        for (std::size_t ip = 0; ip < particles.icell_x.size(); ++ip)
+        {
+            particles.icell_y[ip] = disty(gen);
+            particles.delta_y[ip] = distdelta(gen);
+        }
+    }
+    if constexpr (dim == 3)
+    {
+        std::uniform_int_distribution<int> distz(box.lower[2], box.upper[2]);
+        for (std::size_t ip = 0; ip < particles.icell_x.size(); ++ip)
+        {
+            particles.icell_z[ip] = distz(gen);
+            particles.delta_z[ip] = distdelta(gen);
+        }
+    }
+    load_velocities(particles, gen);
+    return particles;
+}
+
+template<std::size_t dim>
+auto load_particles_ordered(Box<dim> const& box, std::size_t nppc)
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_real_distribution<double> distdelta(0, 1);
+    ParticleArray<dim> particles(nppc * box.size());
+    std::size_t pidx = 0;
+    if constexpr (dim == 1)
+    {
+        for (std::size_t i = box.lower[0]; i <= box.upper[0]; ++i)
+        {
+            for (std::size_t ip = 0; ip < nppc; ++ip)
+            {
+                particles.icell_x[pidx]   = i;
+                particles.delta_x[pidx++] = distdelta(gen);
+            }
+        }
+        load_velocities(particles, gen);
+        return particles;
+    }
+    else if constexpr (dim == 2)
+    {
+        for (std::size_t i = box.lower[0]; i <= box.upper[0]; ++i)
+        {
+            for (std::size_t j = box.lower[1]; j <= box.upper[1]; ++j)
+            {
+                for (std::size_t ip = 0; ip < nppc; ++ip)
+                {
+                    particles.icell_x[pidx]   = i;
+                    particles.icell_y[pidx]   = j;
+                    particles.delta_x[pidx]   = distdelta(gen);
+                    particles.delta_y[pidx++] = distdelta(gen);
+                }
+            }
+        }
+        load_velocities(particles, gen);
+        return particles;
+    }
+    else if constexpr (dim == 3)
+    {
+        for (std::size_t i = box.lower[0]; i <= box.upper[0]; ++i)
+        {
+            for (std::size_t j = box.lower[1]; j <= box.upper[1]; ++j)
+            {
+                for (std::size_t k = box.lower[2]; k <= box.upper[2]; ++k)
+                {
+                    for (std::size_t ip = 0; ip < nppc; ++ip)
+                    {
+                        particles.icell_x[pidx]   = i;
+                        particles.icell_y[pidx]   = j;
+                        particles.icell_z[pidx]   = k;
+                        particles.delta_x[pidx]   = distdelta(gen);
+                        particles.delta_y[pidx]   = distdelta(gen);
+                        particles.delta_z[pidx++] = distdelta(gen);
+                    }
+                }
+            }
+        }
+        load_velocities(particles, gen);
+        return particles;
+    }
+}
+
+// parallel loaders, every number is drawn from (box_id, seed, particle index, stream) with
+//  Philox so the particles do not depend on the thread count, called from a parallel region
+//  (one box per thread, see load_threadbox_particles) they run on the calling thread only
+enum ParticleStream : std::uint32_t { delta_stream = 0, cell_stream = 3, velocity_stream = 6 };
+
+template<std::size_t dim>
+void load_deltas_parallel(ParticleArray<dim>& particles, ParticleRandom const& random)
+{
+    auto const n = particles.icell_x.size();
+#pragma omp parallel for simd
+    for (std::size_t ip = 0; ip < n; ++ip)
+        particles.delta_x[ip] = random.uniform(ip, delta_stream);
+    if constexpr (dim >= 2)
+    {
+#pragma omp parallel for simd
+        for (std::size_t ip = 0; ip < n; ++ip)
+            particles.delta_y[ip] = random.uniform(ip, delta_stream + 1);
+    }
+    if constexpr (dim == 3)
+    {
+#pragma omp parallel for simd
+        for (std::size_t ip = 0; ip < n; ++ip)
+            particles.delta_z[ip] = random.uniform(ip, delta_stream + 2);
+    }
+}
+
+// no simd : vector and scalar log/cos (-ffast-math) could round differently depending on where
+//  a thread's chunk starts
+template<std::size_t dim>
+void load_velocities_parallel(ParticleArray<dim>& particles, ParticleRandom const& random)
+{
+    auto const n = particles.icell_x.size();
+#pragma omp parallel for
+    for (std::size_t ip = 0; ip < n; ++ip)
+    {
+        auto v            = random.normal3(ip, velocity_stream);
+        particles.v_x[ip] = v[0];
+        particles.v_y[ip] = v[1];
+        particles.v_z[ip] = v[2];
+    }
+}
+
+template<std::size_t dim>
+auto load_particles_random_parallel(Box<dim> const& box, std::size_t nppc, std::uint32_t box_id,
+                                    std::uint32_t seed = 1337)
+{
+    ParticleRandom const random{{box_id, seed}};
+    ParticleArray<dim> particles(nppc * box.size());
+    auto const n = particles.icell_x.size();
+
+    auto cell = [&](std::size_t ip, std::size_t d) {
+        auto extent = box.upper[d] - box.lower[d] + 1;
+        auto offset = static_cast<std::size_t>(random.uniform(ip, cell_stream + d) * extent);
+        return static_cast<int>(box.lower[d] + std::min(offset, extent - 1));
+    };
+#pragma omp parallel for simd
+    for (std::size_t ip = 0; ip < n; ++ip)
+        particles.icell_x[ip] = cell(ip, 0);
+    if constexpr (dim >= 2)
+    {
+#pragma omp parallel for simd
+        for (std::size_t ip = 0; ip < n; ++ip)
+            particles.icell_y[ip] = cell(ip, 1);
+    }
+    if constexpr (dim == 3)
+    {
+#pragma omp parallel for simd
+        for (std::size_t ip = 0; ip < n; ++ip)
+            particles.icell_z[ip] = cell(ip, 2);
+    }
+
+    load_deltas_parallel(particles, random);
+    load_velocities_parallel(particles, random);
+    return particles;
+}
+
+// same cell order as load_particles_ordered, last dimension fastest
+template<std::size_t dim>
+auto load_particles_ordered_parallel(Box<dim> const& box, std::size_t nppc, std::uint32_t box_id,
+                                     std::uint32_t seed = 1337)
+{
+    ParticleRandom const random{{box_id, seed}};
+    ParticleArray<dim> particles(nppc * box.size());
+    auto const n = particles.icell_x.size();
+
+    std::array<std::size_t, dim> shape;
+    for (std::size_t d = 0; d < dim; ++d)
+        shape[d] = box.upper[d] - box.lower[d] + 1;
+
+#pragma omp parallel for
+    for (std::size_t ip = 0; ip < n; ++ip)
+    {
+        auto cell = ip / nppc;
+        if constexpr (dim == 3)
+        {
+            particles.icell_z[ip] = box.lower[2] + cell % shape[2];
+            cell /= shape[2];
+        }
+        if constexpr (dim >= 2)
+        {
+            particles.icell_y[ip] = box.lower[1] + cell % shape[1];
+            cell /= shape[1];
+        }
+        particles.icell_x[ip] = box.lower[0] + cell;
+    }
+
+    load_deltas_parallel(particles, random);
+    load_velocities_parallel(particles, random);
+    return particles;
+}
+
+// one particle array per box, box i keyed by i, boxes spread over the threads
+template<std::size_t dim, typename Box_t>
+auto load_threadbox_particles(std::vector<Box_t> const& boxes, std::size_t nppc,
+                              bool ordered = true, std::uint32_t seed = 1337)
+{
+    std::vector<ParticleArray<dim>> particles(boxes.size(), ParticleArray<dim>(0));
+#pragma omp parallel for schedule(dynamic, 1)
+    for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+    {
+        auto id         = static_cast<std::uint32_t>(ibox);
+        particles[ibox] = ordered ? load_particles_ordered_parallel(boxes[ibox], nppc, id, seed)
+                                  : load_particles_random_parallel(boxes[ibox], nppc, id, seed);
+    }
+    return particles;
+}
+
+
+// the same particles stored in another precision
+template<typename Real, std::size_t dim, typename From>
+auto with_precision(ParticleArray<dim, From> const& particles)
+{
+    auto to = [](auto const& v) { return huge_vector<Real>(std::begin(v), std::end(v)); };
+    ParticleArray<dim, Real> converted(0);
+    converted.icell_x = particles.icell_x;
+    converted.delta_x = to(particles.delta_x);
+    if constexpr (dim >= 2)
+    {
+        converted.icell_y = particles.icell_y;
+        converted.delta_y = to(particles.delta_y);
+    }
+    if constexpr (dim == 3)
+    {
+        converted.icell_z = particles.icell_z;
+        converted.delta_z = to(particles.delta_z);
+    }
+    converted.v_x = to(particles.v_x);
+    converted.v_y = to(particles.v_y);
+    converted.v_z = to(particles.v_z);
+    return converted;
+}
+
+// largest difference over the four fields, relative to the largest reference density
+template<std::size_t dim, typename Acc, typename RefAcc>
+double max_deviation(ThreadBox<dim, Acc> const& box, ThreadBox<dim, RefAcc> const& reference)
+{
+    double diff = 0, norm = 0;
+    for (std::size_t i = 0; i < reference.field_size(); ++i)
+    {
+        diff = std::max(diff, std::abs(double(box.density[i]) - reference.density[i]));
+        diff = std::max(diff, std::abs(double(box.fluxx[i]) - reference.fluxx[i]));
+        diff = std::max(diff, std::abs(double(box.fluxy[i]) - reference.fluxy[i]));
+        diff = std::max(diff, std::abs(double(box.fluxz[i]) - reference.fluxz[i]));
+        norm = std::max(norm, std::abs(double(reference.density[i])));
+    }
+    return norm > 0 ? diff / norm : diff;
+}
+
+
+// particles [first, last) only, for splitting one array between tasks
+//  particles are converted to the field precision once on load, weights are computed in it
+template<std::size_t dim, typename Real, typename Acc>
+void deposit(ParticleArray<dim, Real> const& particles, ThreadBox<dim, Acc>& threadbox,
+             std::size_t first = 0, std::size_t last = std::numeric_limits<std::size_t>::max())
+{
+    last = std::min(last, particles.icell_x.size());
+    Acc const one = 1;
+    // node indices are offset by the ghosts and strided by the field shape, as in for_stencil
+    auto const shape  = threadbox.field_shape();
+    auto const ghosts = threadbox.ghosts;
+
+    if constexpr (dim == 1)
+        for (std::size_t ip = first; ip < last; ++ip)
+        {
+            Acc dx = particles.delta_x[ip];
+            auto ix = particles.icell_x[ip] - threadbox.lower[0] + ghosts;
+            Acc vx = particles.v_x[ip];
+            Acc vy = particles.v_y[ip];
+            Acc vz = particles.v_z[ip];
+
+            auto w1 = (one - dx);
+            auto w2 = (dx);
+
+            auto ix1 = ix;
+            auto ix2 = ix + 1;
+
+            threadbox.density[ix1] += w1;
+            threadbox.density[ix2] += w2;
+
+            threadbox.fluxx[ix1] += w1 * vx;
+            threadbox.fluxx[ix2] += w2 * vx;
+
+            threadbox.fluxy[ix1] += w1 * vy;
+            threadbox.fluxy[ix2] += w2 * vy;
+
+            threadbox.fluxz[ix1] += w1 * vz;
+            threadbox.fluxz[ix2] += w2 * vz;
+        }
+    if constexpr (dim == 2)
+    {
+        for (std::size_t ip = first; ip < last; ++ip)
+        {
+            Acc dx = particles.delta_x[ip];
+            Acc dy = particles.delta_y[ip];
+            auto ix = particles.icell_x[ip] - threadbox.lower[0] + ghosts;
+            auto iy = particles.icell_y[ip] - threadbox.lower[1] + ghosts;
+            Acc vx = particles.v_x[ip];
+            Acc vy = particles.v_y[ip];
+            Acc vz = particles.v_z[ip];
+            auto ny = shape[1];
+
+            auto w1 = (one - dx) * (one - dy);
+            auto w2 = (one - dx) * (dy);
+            auto w3 = (dx) * (dy);
+            auto w4 = (dx) * (one - dy);
+
+            auto ixy1 = iy + (ix)*ny;
+            auto ixy2 = iy + 1 + (ix)*ny;
+            auto ixy3 = iy + 1 + (ix + 1) * ny;
+            auto ixy4 = iy + (ix + 1) * ny;
+
+            threadbox.density[ixy1] += w1;
+            threadbox.density[ixy2] += w2;
+            threadbox.density[ixy3] += w3;
+            threadbox.density[ixy4] += w4;
+
+            threadbox.fluxx[ixy1] += w1 * vx;
+            threadbox.fluxx[ixy2] += w2 * vx;
+            threadbox.fluxx[ixy3] += w3 * vx;
+            threadbox.fluxx[ixy4] += w4 * vx;
+
+            threadbox.fluxy[ixy1] += w1 * vy;
+            threadbox.fluxy[ixy2] += w2 * vy;
+            threadbox.fluxy[ixy3] += w3 * vy;
+            threadbox.fluxy[ixy4] += w4 * vy;
+
+            threadbox.fluxz[ixy1] += w1 * vz;
+            threadbox.fluxz[ixy2] += w2 * vz;
+            threadbox.fluxz[ixy3] += w3 * vz;
+            threadbox.fluxz[ixy4] += w4 * vz;
+        }
+    }
+    if constexpr (dim == 3)
+    {
+        auto ny = shape[1];
+        auto nz = shape[2];
+
+        for (std::size_t ip = first; ip < last; ++ip)
+        {
+            Acc dx = particles.delta_x[ip];
+            Acc dy = particles.delta_y[ip];
+            Acc dz = particles.delta_z[ip];
+            auto ix = particles.icell_x[ip] - threadbox.lower[0] + ghosts;
+            auto iy = particles.icell_y[ip] - threadbox.lower[1] + ghosts;
+            auto iz = particles.icell_z[ip] - threadbox.lower[2] + ghosts;
+            Acc vx = particles.v_x[ip];
+            Acc vy = particles.v_y[ip];
+            Acc vz = particles.v_z[ip];
+
+            // trilinear, node (ix + a, iy + b, iz + c) gets wx[a] * wy[b] * wz[c]
+            Acc const wx[2] = {one - dx, dx};
+            Acc const wy[2] = {one - dy, dy};
+            Acc const wz[2] = {one - dz, dz};
+
+            for (std::size_t a = 0; a < 2; ++a)
+            {
+                for (std::size_t b = 0; b < 2; ++b)
+                {
+                    auto ixyz = iz + (iy + b + (ix + a) * ny) * nz;
+                    auto wxy  = wx[a] * wy[b];
+
+                    for (std::size_t c = 0; c < 2; ++c)
+                    {
+                        auto w = wxy * wz[c];
+                        threadbox.density[ixyz + c] += w;
+                        threadbox.fluxx[ixyz + c] += w * vx;
+                        threadbox.fluxy[ixyz + c] += w * vy;
+                        threadbox.fluxz[ixyz + c] += w * vz;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+template<std::size_t d, std::size_t dim, typename Real>
+auto& icell(ParticleArray<dim, Real> const& particles)
+{
+    if constexpr (d == 0)
+        return particles.icell_x;
+    else if constexpr (d == 1)
+        return particles.icell_y;
+    else
+        return particles.icell_z;
+}
+template<std::size_t d, std::size_t dim, typename Real>
+auto& delta(ParticleArray<dim, Real> const& particles)
+{
+    if constexpr (d == 0)
+        return particles.delta_x;
+    else if constexpr (d == 1)
+        return particles.delta_y;
+    else
+        return particles.delta_z;
+}
+
+
+// B-spline weights of the "support" nodes starting at icell + start, delta in [0, 1)
+template<std::size_t order>
+struct Shape
+{
+    static_assert(order > 0 and order < 4, "Only orders 1,2,3 are supported.");
+    static constexpr std::size_t support = order + 1;
+    static constexpr std::size_t ghosts  = order > 1; // nodes needed below lower/above upper+1
+    static constexpr std::size_t flops   = order == 1 ? 1 : order == 2 ? 9 : 19; // per weights()
+
+    // in the precision of delta
+    template<typename Real>
+    static auto weights(Real delta, int& start)
+    {
+        using R = Real;
+        std::array<R, support> w;
+        if constexpr (order == 1)
+        {
+            start = 0;
+            w     = {R(1) - delta, delta};
+        }
+        if constexpr (order == 2) // centered on the nearest node
+        {
+            int shift = delta >= R(0.5);
+            R d       = delta - shift;
+            start     = shift - 1;
+            w         = {R(0.5) * (R(0.5) - d) * (R(0.5) - d), R(0.75) - d * d,
+                         R(0.5) * (R(0.5) + d) * (R(0.5) + d)};
+        }
+        if constexpr (order == 3)
+        {
+            R d   = delta;
+            R d2  = d * d;
+            R d3  = d2 * d;
+            R c   = R(1) - d;
+            start = -1;
+            w     = {c * c * c / R(6), (R(4) - R(6) * d2 + R(3) * d3) / R(6),
+                     (R(1) + R(3) * d + R(3) * d2 - R(3) * d3) / R(6), d3 / R(6)};
+        }
+        return w;
+    }
+};
+
+
+// calls add(field index, weight) on every stencil node of particle ip, the stencil loops are
+//  unrolled at compile time with for_N
+//  the box needs Shape<order>::ghosts ghost nodes
+//  Calc : precision of the weights, deltas are converted to it once
+template<std::size_t order, typename Calc = double, std::size_t dim, typename Real, typename Box_t,
+         typename Add>
+void for_stencil(ParticleArray<dim, Real> const& particles, std::size_t ip, Box_t const& box,
+                 Add&& add)
+{
+    using shape_t          = Shape<order>;
+    constexpr auto support = static_cast<std::uint16_t>(shape_t::support);
+    auto const shape       = box.field_shape();
+
+    std::array<std::array<Calc, support>, dim> w;
+    std::array<std::size_t, dim> first; // first stencil node, in field indices
+    for_N<dim>([&](auto ic) {
+        constexpr auto d = ic();
+        int start;
+        w[d]     = shape_t::weights(static_cast<Calc>(delta<d>(particles)[ip]), start);
+        first[d] = icell<d>(particles)[ip] - box.lower[d] + box.ghosts + start;
+    });
+
+    if constexpr (dim == 1)
+        for_N<support>([&](auto a) { add(first[0] + a, w[0][a]); });
+    if constexpr (dim == 2)
+        for_N<support>([&](auto a) {
+            auto row = (first[0] + a) * shape[1] + first[1];
+            for_N<support>([&](auto b) { add(row + b, w[0][a] * w[1][b]); });
+        });
+    if constexpr (dim == 3)
+        for_N<support>([&](auto a) {
+            for_N<support>([&](auto b) {
+                auto row = ((first[0] + a) * shape[1] + first[1] + b) * shape[2] + first[2];
+                auto wab = w[0][a] * w[1][b];
+                for_N<support>([&](auto c) { add(row + c, wab * w[2][c]); });
+            });
+        });
+}
+
+// any order in any dimension, computed in the field precision
+//  atomic : threads may share the threadbox
+template<std::size_t dim, std::size_t order, bool atomic = false, typename Real, typename Acc>
+void deposit_shaped(ParticleArray<dim, Real> const& particles, ThreadBox<dim, Acc>& threadbox)
+{
+    for (std::size_t ip = 0; ip < particles.icell_x.size(); ++ip)
+    {
+        Acc const v[3] = {static_cast<Acc>(particles.v_x[ip]), static_cast<Acc>(particles.v_y[ip]),
+                          static_cast<Acc>(particles.v_z[ip])};
+
+        for_stencil<order, Acc>(particles, ip, threadbox, [&](std::size_t idx, Acc weight) {
+            if constexpr (atomic)
+            {
+#pragma omp atomic
+                threadbox.density[idx] += weight;
+#pragma omp atomic
+                threadbox.fluxx[idx] += weight * v[0];
+#pragma omp atomic
+                threadbox.fluxy[idx] += weight * v[1];
+#pragma omp atomic
+                threadbox.fluxz[idx] += weight * v[2];
+            }
+            else
+            {
+                threadbox.density[idx] += weight;
+                threadbox.fluxx[idx] += weight * v[0];
+                threadbox.fluxy[idx] += weight * v[1];
+                threadbox.fluxz[idx] += weight * v[2];
+            }
+        });
+    }
+}
+
+// first order keeps the hand written kernels above
+template<std::size_t dim, std::size_t order, typename Real, typename Acc>
+void deposit(ParticleArray<dim, Real> const& particles, ThreadBox<dim, Acc>& threadbox)
+{
+    if constexpr (order == 1)
+        deposit<dim>(particles, threadbox);
+    else
+        deposit_shaped<dim, order>(particles, threadbox);
+}
+
+
+// particles of a run share one cell, run ends at the first particle in another cell
+template<std::size_t dim>
+auto end_of_run(ParticleArray<dim> const& particles, std::size_t first)
+{
+    auto last = first + 1;
+    auto n    = particles.icell_x.size();
+    auto same = [&](std::size_t ip) {
+        bool same_cell = particles.icell_x[ip] == particles.icell_x[first];
+        if constexpr (dim >= 2)
+            same_cell = same_cell and particles.icell_y[ip] == particles.icell_y[first];
+        if constexpr (dim == 3)
+            same_cell = same_cell and particles.icell_z[ip] == particles.icell_z[first];
+        return same_cell;
+    };
+    while (last < n and same(last))
+        ++last;
+    return last;
+}
+
+// mean run length over the first "sample" particles, ~1 when unsorted
+template<std::size_t dim>
+double mean_run_length(ParticleArray<dim> const& particles, std::size_t sample = 1024)
+{
+    auto n           = std::min(sample, particles.icell_x.size());
+    std::size_t runs = 0;
+    for (std::size_t first = 0; first < n; first = end_of_run(particles, first))
+        ++runs;
+    return runs ? static_cast<double>(n) / runs : 0.;
+}
+
+
+// first order weights of the 2^dim nodes of particle ip, node k is (a, b, c) binary : the bit
+//  of dimension d is (k >> (dim - 1 - d)) & 1
+template<std::size_t dim>
+auto node_weights(ParticleArray<dim> const& particles, std::size_t ip)
+{
+    auto const dx = particles.delta_x[ip];
+    if constexpr (dim == 1)
+        return std::array<double, 2>{1.0 - dx, dx};
+    else
+    {
+        auto const dy  = particles.delta_y[ip];
+        auto const w00 = (1.0 - dx) * (1.0 - dy), w01 = (1.0 - dx) * dy;
+        auto const w10 = dx * (1.0 - dy), w11 = dx * dy;
+        if constexpr (dim == 2)
+            return std::array<double, 4>{w00, w01, w10, w11};
+        else
+        {
+            auto const dz = particles.delta_z[ip];
+            return std::array<double, 8>{w00 * (1.0 - dz), w00 * dz, w01 * (1.0 - dz), w01 * dz,
+                                         w10 * (1.0 - dz), w10 * dz, w11 * (1.0 - dz), w11 * dz};
+        }
+    }
+}
+
+// first order weight and weight * (vx, vy, vz) of the 2^dim nodes of the run [first, last),
+//  summed in one pass over the run
+//  particle ip goes to lane (ip - first) % lanes of the 4 * 2^dim accumulators, the lanes are
+//  independent so each block of lanes particles is one simd step with a vector accumulator per
+//  moment, the lanes are summed at the end
+//  moments[k * 4 + m] : m = 0 density, 1..3 flux x, y, z
+template<std::size_t dim>
+auto run_moments(ParticleArray<dim> const& particles, std::size_t first, std::size_t last)
+{
+    constexpr std::size_t nodes = 1 << dim, lanes = 4;
+    alignas(64) std::array<std::array<double, lanes>, 4 * nodes> acc{};
+    auto add = [&](std::size_t ip, std::size_t lane) {
+        auto const w      = node_weights(particles, ip);
+        double const v[4] = {1.0, particles.v_x[ip], particles.v_y[ip], particles.v_z[ip]};
+        for_N<nodes>([&](auto k) {
+            for_N<4>([&](auto m) { acc[k * 4 + m][lane] += w[k] * v[m]; });
+        });
+    };
+
+    auto ip = first;
+    for (; ip + lanes <= last; ip += lanes)
+#pragma omp simd
+        for (std::size_t lane = 0; lane < lanes; ++lane)
+            add(ip + lane, lane);
+    for (std::size_t lane = 0; ip < last; ++ip, ++lane)
+        add(ip, lane);
+
+    std::array<double, 4 * nodes> moments{};
+    for (std::size_t j = 0; j < moments.size(); ++j)
+        for (auto a : acc[j])
+            moments[j] += a;
+    return moments;
+}
+
+// first order deposit for cell sorted particles
+//  every particle of a run hits the same 2^dim nodes, so the run's weights (and weight * v) are
+//  summed first and each node is written once per run instead of once per particle, unsorted
+//  input (short runs) falls back to deposit<dim>
+template<std::size_t dim>
+void deposit_sorted(ParticleArray<dim> const& particles, ThreadBox<dim>& threadbox)
+{
+    constexpr double min_run_length = 2;
+    if (mean_run_length(particles) < min_run_length)
+        return deposit<dim>(particles, threadbox);
+
+    auto const shape = threadbox.field_shape();
+    auto n           = particles.icell_x.size();
+    for (std::size_t first = 0, last = 0; first < n; first = last)
+    {
+        last = end_of_run(particles, first);
+
+        auto const m = run_moments(particles, first, last);
+
+        // node (0, 0, 0) of the run's cell, in field indices
+        std::size_t origin = 0;
+        for_N<dim>([&](auto ic) {
+            constexpr auto d = ic();
+            origin = origin * shape[d] + icell<d>(particles)[first] - threadbox.lower[d]
+                     + threadbox.ghosts;
+        });
+
+        for_N<(1 << dim)>([&](auto k) {
+            std::size_t idx = 0;
+            for_N<dim>([&](auto ic) {
+                constexpr auto d = ic();
+                idx = idx * shape[d] + ((k() >> (dim - 1 - d)) & 1);
+            });
+            threadbox.density[origin + idx] += m[k() * 4];
+            threadbox.fluxx[origin + idx] += m[k() * 4 + 1];
+            threadbox.fluxy[origin + idx] += m[k() * 4 + 2];
+            threadbox.fluxz[origin + idx] += m[k() * 4 + 3];
+        });
+    }
+}
+
+
+// node-major interleaved moments : the four moments of a node share 32 aligned bytes, so a
+//  cache line holds two nodes and a particle touches 2^dim half lines instead of 4 * 2^dim
+//  lines spread over four fields
+struct alignas(32) Moments
+{
+    double density = 0;
+    double fluxx   = 0;
+    double fluxy   = 0;
+    double fluxz   = 0;
+};
+static_assert(sizeof(Moments) == 4 * sizeof(double));
+
+// same nodes (and ghosts) as ThreadBox
+template<std::size_t dim>
+struct MomentBox : Box<dim>
+{
+    MomentBox(std::array<std::size_t, dim> lower_, std::array<std::size_t, dim> upper_,
+              std::size_t ghosts_ = 0)
+        : Box<dim>(lower_, upper_)
+        , ghosts{ghosts_}
+        , moments(field_size())
+    {
+    }
+    auto field_shape() const
+    {
+        std::array<std::size_t, dim> shape;
+        for (std::size_t i = 0; i < dim; ++i)
+            shape[i] = this->upper[i] - this->lower[i] + 2 + 2 * ghosts;
+        return shape;
+    }
+    auto field_size() const
+    {
+        auto shape = field_shape();
+        return std::accumulate(std::begin(shape), std::end(shape), std::size_t{1},
+                               std::multiplies<std::size_t>());
+    }
+    std::size_t ghosts;
+    huge_vector<Moments> moments; // 2MB pages, or aligned new when small
+};
+
+
+// one moment of a MomentBox seen as a field, for the per-component consumers
+//  Moments_t : Moments or Moments const
+template<typename Moments_t>
+class MomentView
+{
+public:
+    using value_type = std::conditional_t<std::is_const_v<Moments_t>, double const, double>;
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = double;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = MomentView::value_type*;
+        using reference         = MomentView::value_type&;
+
+        iterator(Moments_t* node, double Moments::*member)
+            : node_{node}
+            , member_{member}
+        {
+        }
+        reference operator*() const { return node_->*member_; }
+        iterator& operator++()
+        {
+            ++node_;
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            auto copy = *this;
+            ++node_;
+            return copy;
+        }
+        bool operator==(iterator const& that) const { return node_ == that.node_; }
+        bool operator!=(iterator const& that) const { return node_ != that.node_; }
+
+    private:
+        Moments_t* node_;
+        double Moments::*member_;
+    };
+
+    MomentView(Moments_t* nodes, std::size_t size, double Moments::*member)
+        : nodes_{nodes}
+        , size_{size}
+        , member_{member}
+    {
+    }
+    value_type& operator[](std::size_t i) const { return nodes_[i].*member_; }
+    auto size() const { return size_; }
+    auto begin() const { return iterator{nodes_, member_}; }
+    auto end() const { return iterator{nodes_ + size_, member_}; }
+
+private:
+    Moments_t* nodes_;
+    std::size_t size_;
+    double Moments::*member_;
+};
+
+template<typename Box_t> // MomentBox<dim> or MomentBox<dim> const
+auto moment_view(Box_t& box, double Moments::*member)
+{
+    using moments_t = std::remove_pointer_t<decltype(box.moments.data())>;
+    return MomentView<moments_t>{box.moments.data(), box.moments.size(), member};
+}
+template<typename Box_t>
+auto density(Box_t& box)
+{
+    return moment_view(box, &Moments::density);
+}
+template<typename Box_t>
+auto fluxx(Box_t& box)
+{
+    return moment_view(box, &Moments::fluxx);
+}
+template<typename Box_t>
+auto fluxy(Box_t& box)
+{
+    return moment_view(box, &Moments::fluxy);
+}
+template<typename Box_t>
+auto fluxz(Box_t& box)
+{
+    return moment_view(box, &Moments::fluxz);
+}
+
+
+// fused moment deposit, density and fluxes of a node updated together
+//  particles [first, last) only, the box needs Shape<order>::ghosts ghost nodes
+template<std::size_t dim, std::size_t order = 1>
+void deposit_moments(ParticleArray<dim> const& particles, MomentBox<dim>& box,
+                     std::size_t first = 0,
+                     std::size_t last  = std::numeric_limits<std::size_t>::max())
+{
+    last = std::min(last, particles.icell_x.size());
+
+    for (std::size_t ip = first; ip < last; ++ip)
+    {
+        auto vx = particles.v_x[ip];
+        auto vy = particles.v_y[ip];
+        auto vz = particles.v_z[ip];
+
+        for_stencil<order>(particles, ip, box, [&](std::size_t idx, double weight) {
+            auto& node = box.moments[idx];
+            node.density += weight;
+            node.fluxx += weight * vx;
+            node.fluxy += weight * vy;
+            node.fluxz += weight * vz;
+        });
+    }
+}
+
+
+// tiled fields : nodes stored tile by tile, tiles of T^dim nodes (T a power of 2), row-major
+//  inside a tile and between tiles, edge tiles padded to full size
+//  a flat row-major field puts the (ix + 1) row of the stencil shape[1] nodes away, in a tile
+//  all 2^dim stencil nodes share the tile unless the cell sits on a tile edge, so with particles
+//  ordered by tile a tile's fields stay in L1 while its particles deposit
+
+constexpr std::size_t ilog2(std::size_t n)
+{
+    return n < 2 ? 0 : 1 + ilog2(n / 2);
+}
+
+template<std::size_t dim, std::size_t T = (dim == 3 ? 4 : 8)>
+struct TiledBox : Box<dim>
+{
+    static_assert(T > 1 and (T & (T - 1)) == 0, "tile edge must be a power of 2");
+    static constexpr std::size_t bits      = ilog2(T);
+    static constexpr std::size_t mask      = T - 1;
+    static constexpr std::size_t tile_bits = bits * dim; // nodes per tile = 1 << tile_bits
+
+    TiledBox(std::array<std::size_t, dim> lower_, std::array<std::size_t, dim> upper_)
+        : Box<dim>(lower_, upper_)
+        , ntiles{tile_counts(lower_, upper_)}
+        , density(field_size())
+        , fluxx(field_size())
+        , fluxy(field_size())
+        , fluxz(field_size())
+    {
+    }
+
+    // node in field coordinates (0 is lower), as in ThreadBox without ghosts
+    std::size_t index(std::array<std::size_t, dim> const& node) const
+    {
+        std::size_t tile = 0, local = 0;
+        for (std::size_t d = 0; d < dim; ++d)
+        {
+            tile  = tile * ntiles[d] + (node[d] >> bits);
+            local = (local << bits) + (node[d] & mask);
+        }
+        return (tile << tile_bits) + local;
+    }
+
+    auto field_size() const
+    {
+        return std::accumulate(std::begin(ntiles), std::end(ntiles), std::size_t{1},
+                               std::multiplies<std::size_t>())
+               << tile_bits;
+    }
+
+    std::array<std::size_t, dim> ntiles;
+    huge_vector<double> density;
+    huge_vector<double> fluxx;
+    huge_vector<double> fluxy;
+    huge_vector<double> fluxz;
+
+private:
+    static auto tile_counts(std::array<std::size_t, dim> const& lower,
+                            std::array<std::size_t, dim> const& upper)
+    {
+        std::array<std::size_t, dim> counts;
+        for (std::size_t d = 0; d < dim; ++d)
+            counts[d] = (upper[d] - lower[d] + 2 + mask) >> bits; // primal nodes, rounded up
+        return counts;
+    }
+};
+
+// first order deposit into the tiled fields, the 2^dim stencil nodes are unrolled with for_N
+template<std::size_t dim, std::size_t T>
+void deposit_tiled(ParticleArray<dim> const& particles, TiledBox<dim, T>& box)
+{
+    using box_t             = TiledBox<dim, T>;
+    constexpr auto ncorners = static_cast<std::uint16_t>(1 << dim);
+
+    for (std::size_t ip = 0; ip < particles.icell_x.size(); ++ip)
+    {
+        // tile and in-tile coordinates of the two stencil nodes in each direction
+        std::array<std::array<std::size_t, 2>, dim> tile, local;
+        std::array<std::array<double, 2>, dim> w;
+        for_N<dim>([&](auto ic) {
+            constexpr auto d = ic();
+            std::size_t node = icell<d>(particles)[ip] - box.lower[d];
+            tile[d]          = {node >> box_t::bits, (node + 1) >> box_t::bits};
+            local[d]         = {node & box_t::mask, (node + 1) & box_t::mask};
+            auto delta_d     = delta<d>(particles)[ip];
+            w[d]             = {1.0 - delta_d, delta_d};
+        });
+        auto vx = particles.v_x[ip];
+        auto vy = particles.v_y[ip];
+        auto vz = particles.v_z[ip];
+
+        for_N<ncorners>([&](auto corner) {
+            std::size_t t = 0, l = 0;
+            double weight = 1;
+            for_N<dim>([&](auto ic) {
+                constexpr auto d = ic();
+                constexpr auto a = (corner() >> (dim - 1 - d)) & 1;
+                t                = t * box.ntiles[d] + tile[d][a];
+                l                = (l << box_t::bits) + local[d][a];
+                weight *= w[d][a];
+            });
+            auto idx = (t << box_t::tile_bits) + l;
+            box.density[idx] += weight;
+            box.fluxx[idx] += weight * vx;
+            box.fluxy[idx] += weight * vy;
+            box.fluxz[idx] += weight * vz;
+        });
+    }
+}
+
+// particles sorted by tile then cell (stable counting sort on the tiled index of their cell)
+template<std::size_t dim, std::size_t T>
+void order_by_tile(ParticleArray<dim>& particles, TiledBox<dim, T> const& box)
+{
+    auto const n = particles.icell_x.size();
+    std::vector<std::size_t> key(n), offset(box.field_size() + 1);
+    for (std::size_t ip = 0; ip < n; ++ip)
+    {
+        std::array<std::size_t, dim> node;
+        for_N<dim>([&](auto ic) {
+            constexpr auto d = ic();
+            node[d]          = icell<d>(particles)[ip] - box.lower[d];
+        });
+        key[ip] = box.index(node);
+        ++offset[key[ip] + 1];
+    }
+    std::partial_sum(std::begin(offset), std::end(offset), std::begin(offset));
+
+    std::vector<std::size_t> destination(n);
+    for (std::size_t ip = 0; ip < n; ++ip)
+        destination[ip] = offset[key[ip]]++;
+
+    auto permute = [&](auto& v) {
+        auto const copy = v;
+        for (std::size_t ip = 0; ip < n; ++ip)
+            v[destination[ip]] = copy[ip];
+    };
+    permute(particles.icell_x);
+    permute(particles.delta_x);
+    if constexpr (dim >= 2)
+    {
+        permute(particles.icell_y);
+        permute(particles.delta_y);
+    }
+    if constexpr (dim == 3)
+    {
+        permute(particles.icell_z);
+        permute(particles.delta_z);
+    }
+    permute(particles.v_x);
+    permute(particles.v_y);
+    permute(particles.v_z);
+}
+
+// the tiled fields into a flat ThreadBox of the same box (no ghosts), for flat layout consumers
+template<std::size_t dim, std::size_t T>
+void copy_to(TiledBox<dim, T> const& tiled, ThreadBox<dim>& flat)
+{
+    auto const shape = flat.field_shape();
+    for (std::size_t i = 0; i < flat.field_size(); ++i)
+    {
+        std::array<std::size_t, dim> node;
+        for (std::size_t d = dim, rest = i; d-- > 0;)
+        {
+            node[d] = rest % shape[d];
+            rest /= shape[d];
+        }
+        auto idx         = tiled.index(node);
+        flat.density[i] = tiled.density[idx];
+        flat.fluxx[i]   = tiled.fluxx[idx];
+        flat.fluxy[i]   = tiled.fluxy[idx];
+        flat.fluxz[i]   = tiled.fluxz[idx];
+    }
+}
+
+
+// field to particle interpolation, the gather twin of the deposit : E and B on the nodes of a box
+//  with the ghosts of the shape, each particle sums the six components over its stencil
+//  cell sorted input loads the window of nodes any particle of the cell can reach once per run
+//  unsorted input prefetches the stencil rows of particle ip + distance, the distance and read
+//  hint of a GatherConfig (prefetch/gather.hpp, tuned_gather_config for the persisted one)
+
+template<std::size_t dim>
+struct EMBox : Box<dim>
+{
+    EMBox(std::array<std::size_t, dim> lower_, std::array<std::size_t, dim> upper_,
+          std::size_t ghosts_ = 0)
+        : Box<dim>(lower_, upper_)
+        , ghosts{ghosts_}
+        , Ex(field_size())
+        , Ey(field_size())
+        , Ez(field_size())
+        , Bx(field_size())
+        , By(field_size())
+        , Bz(field_size())
+    {
+    }
+    auto field_shape() const
+    {
+        std::array<std::size_t, dim> shape;
+        for (std::size_t i = 0; i < dim; ++i)
+            shape[i] = this->upper[i] - this->lower[i] + 2 + 2 * ghosts;
+        return shape;
+    }
+    auto field_size() const
+    {
+        auto shape = field_shape();
+        return std::accumulate(std::begin(shape), std::end(shape), std::size_t{1},
+                               std::multiplies<std::size_t>());
+    }
+    auto components() const { return std::array{&Ex, &Ey, &Ez, &Bx, &By, &Bz}; }
+    auto components() { return std::array{&Ex, &Ey, &Ez, &Bx, &By, &Bz}; }
+
+    std::size_t ghosts;
+    huge_vector<double> Ex;
+    huge_vector<double> Ey;
+    huge_vector<double> Ez;
+    huge_vector<double> Bx;
+    huge_vector<double> By;
+    huge_vector<double> Bz;
+};
+
+// E and B at the particles, in the order of the ParticleArray they were interpolated for
+struct ParticleEM
+{
+    explicit ParticleEM(std::size_t n)
+        : Ex(n)
+        , Ey(n)
+        , Ez(n)
+        , Bx(n)
+        , By(n)
+        , Bz(n)
+    {
+    }
+    auto components() { return std::array{&Ex, &Ey, &Ez, &Bx, &By, &Bz}; }
+    auto components() const { return std::array{&Ex, &Ey, &Ez, &Bx, &By, &Bz}; }
+
+    huge_vector<double> Ex;
+    huge_vector<double> Ey;
+    huge_vector<double> Ez;
+    huge_vector<double> Bx;
+    huge_vector<double> By;
+    huge_vector<double> Bz;
+};
+
+// nodes per direction any particle of a cell reaches, from Shape<order>::ghosts below the cell
+//  node : order 2 starts one node lower or not depending on delta
+template<std::size_t order>
+constexpr std::size_t stencil_window = order == 1 ? 2 : 4;
+
+// plain and prefetching : every particle reads its own stencil
+template<std::size_t dim, std::size_t order, int locality = 3>
+void interpolate_unsorted(ParticleArray<dim> const& particles, EMBox<dim> const& fields,
+                          ParticleEM& em, std::size_t distance = 0)
+{
+    constexpr auto window = static_cast<std::uint16_t>(stencil_window<order>);
+    auto const shape      = fields.field_shape();
+    auto const in         = fields.components();
+    auto const out        = em.components();
+    auto const n          = particles.icell_x.size();
+
+    // every stencil row of the window, for the six components
+    auto prefetch = [&](std::size_t ip) {
+        std::array<std::size_t, dim> node;
+        for_N<dim>([&](auto ic) {
+            constexpr auto d = ic();
+            node[d] = icell<d>(particles)[ip] - fields.lower[d] + fields.ghosts
+                      - Shape<order>::ghosts;
+        });
+        auto row = [&](std::size_t idx) {
+            for (auto const* component : in)
+                __builtin_prefetch(component->data() + idx, 0, locality);
+        };
+        if constexpr (dim == 1)
+            row(node[0]);
+        if constexpr (dim == 2)
+            for_N<window>([&](auto a) { row((node[0] + a) * shape[1] + node[1]); });
+        if constexpr (dim == 3)
+            for_N<window>([&](auto a) {
+                for_N<window>([&](auto b) {
+                    row(((node[0] + a) * shape[1] + node[1] + b) * shape[2] + node[2]);
+                });
+            });
+    };
+
+    for (std::size_t ip = 0; ip < n; ++ip)
+    {
+        if (distance > 0 and ip + distance < n)
+            prefetch(ip + distance);
+        std::array<double, 6> sum{};
+        for_stencil<order>(particles, ip, fields, [&](std::size_t idx, double weight) {
+            for (std::size_t m = 0; m < 6; ++m)
+                sum[m] += weight * (*in[m])[idx];
+        });
+        for (std::size_t m = 0; m < 6; ++m)
+            (*out[m])[ip] = sum[m];
+    }
+}
+
+// cell sorted : the window of the run's cell is copied to a node-major local array once and
+//  the particles of the run read from it, the summation order is the one of for_stencil
+template<std::size_t dim, std::size_t order>
+void interpolate_sorted(ParticleArray<dim> const& particles, EMBox<dim> const& fields,
+                        ParticleEM& em)
+{
+    using shape_t          = Shape<order>;
+    constexpr auto window  = static_cast<std::uint16_t>(stencil_window<order>);
+    constexpr auto support = static_cast<std::uint16_t>(shape_t::support);
+    constexpr auto nodes   = window * (dim > 1 ? window : 1) * (dim > 2 ? window : 1);
+    auto const shape       = fields.field_shape();
+    auto const in          = fields.components();
+    auto const out         = em.components();
+    auto const n           = particles.icell_x.size();
+
+    std::array<std::array<double, 6>, nodes> local;
+    for (std::size_t first = 0, last = 0; first < n; first = last)
+    {
+        last = end_of_run(particles, first);
+
+        std::array<std::size_t, dim> node;
+        for_N<dim>([&](auto ic) {
+            constexpr auto d = ic();
+            node[d] = icell<d>(particles)[first] - fields.lower[d] + fields.ghosts
+                      - shape_t::ghosts;
+        });
+        for (std::size_t l = 0; l < nodes; ++l)
+        {
+            std::size_t idx = 0;
+            for (std::size_t d = 0, rest = l, stride = nodes; d < dim; ++d)
+            {
+                stride /= window;
+                idx = idx * shape[d] + node[d] + rest / stride;
+                rest %= stride;
+            }
+            for (std::size_t m = 0; m < 6; ++m)
+                local[l][m] = (*in[m])[idx];
+        }
+
+        for (std::size_t ip = first; ip < last; ++ip)
+        {
+            std::array<std::array<double, support>, dim> w;
+            std::array<std::size_t, dim> o; // first stencil node in the window
+            for_N<dim>([&](auto ic) {
+                constexpr auto d = ic();
+                int start;
+                w[d] = shape_t::weights(delta<d>(particles)[ip], start);
+                o[d] = start + shape_t::ghosts;
+            });
+
+            std::array<double, 6> sum{};
+            auto add = [&](std::size_t l, double weight) {
+                for (std::size_t m = 0; m < 6; ++m)
+                    sum[m] += weight * local[l][m];
+            };
+            if constexpr (dim == 1)
+                for_N<support>([&](auto a) { add(o[0] + a, w[0][a]); });
+            if constexpr (dim == 2)
+                for_N<support>([&](auto a) {
+                    auto row = (o[0] + a) * window + o[1];
+                    for_N<support>([&](auto b) { add(row + b, w[0][a] * w[1][b]); });
+                });
+            if constexpr (dim == 3)
+                for_N<support>([&](auto a) {
+                    for_N<support>([&](auto b) {
+                        auto row = ((o[0] + a) * window + o[1] + b) * window + o[2];
+                        auto wab = w[0][a] * w[1][b];
+                        for_N<support>([&](auto c) { add(row + c, wab * w[2][c]); });
+                    });
+                });
+            for (std::size_t m = 0; m < 6; ++m)
+                (*out[m])[ip] = sum[m];
+        }
+    }
+}
+
+// sorted when runs are long enough to share the window, else prefetching with config
+template<std::size_t dim, std::size_t order>
+void interpolate(ParticleArray<dim> const& particles, EMBox<dim> const& fields, ParticleEM& em,
+                 GatherConfig const& config = GatherConfig{8, 3, -1, 1})
+{
+    constexpr double min_run_length = 2;
+    if (mean_run_length(particles) >= min_run_length)
+        return interpolate_sorted<dim, order>(particles, fields, em);
+    gather_detail::with_constant<0, 1, 2, 3>(config.read_locality, [&](auto locality) {
+        interpolate_unsorted<dim, order, locality()>(particles, fields, em, config.distance);
+    });
+}
+
+
+// roofline model of the deposits, counted from the kernels above
+//  bytes : compulsory traffic, each particle read once (icell, delta, v) and the fields of a box
+//  read and written once per deposit, the stencil reuse of the fields is assumed to hit cache
+//  flops : shape weights, their tensor products, then 7 per node (density add, 3 flux mul+add)
+template<std::size_t dim, typename Real = double>
+constexpr std::size_t particle_bytes = dim * (sizeof(int) + sizeof(Real)) + 3 * sizeof(Real);
+
+template<typename Box_t> // ThreadBox or MomentBox, same four doubles per node
+std::size_t field_bytes(Box_t const& box)
+{
+    return 2 * 4 * sizeof(double) * box.field_size();
+}
+
+template<std::size_t dim, std::size_t order>
+constexpr std::size_t deposit_flops()
+{
+    constexpr std::size_t support = Shape<order>::support;
+
+    std::size_t nodes = 1, products = 0;
+    for (std::size_t d = 0; d < dim; ++d)
+    {
+        nodes *= support;
+        if (d > 0)
+            products += nodes;
+    }
+    return dim * Shape<order>::flops + products + 7 * nodes;
+}
+
+
+// all threadboxes of size TB^dim tiling [0, N)^dim
+template<std::size_t dim>
+auto make_threadboxes(std::size_t N, std::size_t TB, std::size_t ghosts = 0)
+{
+    std::vector<ThreadBox<dim>> boxes;
+    std::array<std::size_t, dim> start{};
+    while (start[0] < N)
+    {
+        std::array<std::size_t, dim> end;
+        for (std::size_t i = 0; i < dim; ++i)
+            end[i] = start[i] + TB - 1;
+        boxes.emplace_back(start, end, ghosts);
+
+        for (std::size_t i = dim; i-- > 0;) // odometer, last dimension fastest
+        {
+            start[i] += TB;
+            if (start[i] < N or i == 0)
+                break;
+            start[i] = 0;
+        }
+    }
+    return boxes;
+}
+
+
+// global deposit, one domain wide field from all threadboxes
+//  neighbouring threadboxes share their border nodes, boxes of the same colour (parity of the
+//  box position in each direction) never touch, so the 2^dim colours can each run in parallel
+
+
+// bit d is the parity of the box position in direction d
+template<std::size_t dim>
+std::size_t colour(Box<dim> const& box, std::size_t TB)
+{
+    std::size_t c = 0;
+    for (std::size_t d = 0; d < dim; ++d)
+        c |= ((box.lower[d] / TB) % 2) << d;
+    return c;
+}
+
+template<std::size_t dim, typename Acc>
+void zero(ThreadBox<dim, Acc>& box)
+{
+    for (auto* field : {&box.density, &box.fluxx, &box.fluxy, &box.fluxz})
+        std::fill(std::begin(*field), std::end(*field), Acc{0});
+}
+
+template<std::size_t dim, std::size_t T>
+void zero(TiledBox<dim, T>& box)
+{
+    for (auto* field : {&box.density, &box.fluxx, &box.fluxy, &box.fluxz})
+        std::fill(std::begin(*field), std::end(*field), 0.);
+}
+
+// add the (ghost free) fields of box into domain, which contains it
+template<std::size_t dim>
+void reduce_into(ThreadBox<dim> const& box, ThreadBox<dim>& domain)
+{
+    auto const shape  = box.field_shape();
+    auto const dshape = domain.field_shape();
+    auto const row    = shape[dim - 1];
+    auto const nrows  = box.field_size() / row;
+
+    for (std::size_t r = 0; r < nrows; ++r)
+    {
+        std::size_t offset = 0, rest = r;
+        std::array<std::size_t, dim> node{};
+        for (std::size_t d = dim - 1; d-- > 0;)
+        {
+            node[d] = rest % shape[d];
+            rest /= shape[d];
+        }
+        for (std::size_t d = 0; d + 1 < dim; ++d)
+            offset = (offset + node[d] + box.lower[d] - domain.lower[d]) * dshape[d + 1];
+        offset += box.lower[dim - 1] - domain.lower[dim - 1];
+
+        auto const from = r * row;
+        for (std::size_t i = 0; i < row; ++i)
+        {
+            domain.density[offset + i] += box.density[from + i];
+            domain.fluxx[offset + i] += box.fluxx[from + i];
+            domain.fluxy[offset + i] += box.fluxy[from + i];
+            domain.fluxz[offset + i] += box.fluxz[from + i];
+        }
+    }
+}
+
+// threadboxes deposit straight into the domain, one colour at a time
+template<std::size_t dim>
+void deposit_global_colored(std::vector<ParticleArray<dim>> const& particles,
+                            std::vector<ThreadBox<dim>> const& boxes, std::size_t TB,
+                            ThreadBox<dim>& domain)
+{
+    for (std::size_t c = 0; c < (std::size_t{1} << dim); ++c)
+    {
+#pragma omp parallel for
+        for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+        {
+            if (colour(boxes[ibox], TB) == c)
+                deposit<dim>(particles[ibox], domain);
+        }
+    }
+}
+
+// threadboxes deposit into their private fields all at once, then are reduced into the
+//  domain one colour at a time
+template<std::size_t dim>
+void deposit_global_reduced(std::vector<ParticleArray<dim>> const& particles,
+                            std::vector<ThreadBox<dim>>& boxes, std::size_t TB,
+                            ThreadBox<dim>& domain)
+{
+#pragma omp parallel
+    {
+#pragma omp for
+        for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+        {
+            zero(boxes[ibox]);
+            deposit<dim>(particles[ibox], boxes[ibox]);
+        }
+        for (std::size_t c = 0; c < (std::size_t{1} << dim); ++c)
+        {
+#pragma omp for
+            for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+            {
+                if (colour(boxes[ibox], TB) == c)
+                    reduce_into(boxes[ibox], domain);
+            }
+        }
+    }
+}
+
+// every threadbox deposits into the domain with atomic adds
+template<std::size_t dim>
+void deposit_global_atomic(std::vector<ParticleArray<dim>> const& particles,
+                           ThreadBox<dim>& domain)
+{
+#pragma omp parallel for
+    for (std::size_t ibox = 0; ibox < particles.size(); ++ibox)
+    {
+        deposit_shaped<dim, 1, /*atomic=*/true>(particles[ibox], domain);
+    }
+}
+
+// every thread deposits into its own full size copy of the domain, copies are summed after
+//  copies needs one domain sized ThreadBox per thread
+template<std::size_t dim>
+void deposit_global_copies(std::vector<ParticleArray<dim>> const& particles,
+                           std::vector<ThreadBox<dim>>& copies, ThreadBox<dim>& domain)
+{
+#pragma omp parallel
+    {
+        auto& copy = copies[omp_get_thread_num()];
+        zero(copy);
+#pragma omp for
+        for (std::size_t ibox = 0; ibox < particles.size(); ++ibox)
+        {
+            deposit<dim>(particles[ibox], copy);
+        }
+        auto nthreads = static_cast<std::size_t>(omp_get_num_threads());
+#pragma omp for
+        for (std::size_t i = 0; i < domain.field_size(); ++i)
+        {
+            for (std::size_t t = 0; t < nthreads; ++t)
+            {
+                domain.density[i] += copies[t].density[i];
+                domain.fluxx[i] += copies[t].fluxx[i];
+                domain.fluxy[i] += copies[t].fluxy[i];
+                domain.fluxz[i] += copies[t].fluxz[i];
+            }
+        }
+    }
+}
+
+
+// particle count weighted scheduling of the (independent) threadboxes
+//  tasks are ordered by particle count and dealt longest first round robin to per thread
+//  queues, a thread takes its largest task from the front of its own queue and steals the
+//  smallest from the back of the others when it runs out
+//  a box with more than 1/nthreads of all particles is split into chunks of at most that, the
+//  chunks after the first deposit into scratch fields added to the box once all tasks are done
+
+
+struct DepositTask
+{
+    static constexpr std::size_t no_scratch = std::numeric_limits<std::size_t>::max();
+
+    std::size_t ibox, first, last;
+    std::size_t scratch = no_scratch; // deposits into the box itself without
+    std::size_t size() const { return last - first; }
+};
+
+// busy : time in tasks and scratch reduction, idle : the rest of the parallel region
+struct ThreadTimes
+{
+    double busy       = 0;
+    double idle       = 0;
+    std::size_t tasks = 0, stolen = 0;
+};
+
+
+template<std::size_t dim>
+class DepositScheduler
+{
+public:
+    DepositScheduler(std::vector<ParticleArray<dim>> const& particles,
+                     std::vector<ThreadBox<dim>> const& boxes, std::size_t nthreads_,
+                     bool split = true)
+        : nthreads{nthreads_}
+        , queues(nthreads_)
+        , scratch_of_box(boxes.size())
+    {
+        std::size_t total = 0;
+        for (auto const& p : particles)
+            total += p.icell_x.size();
+        auto const chunk = split ? std::max<std::size_t>(1, (total + nthreads - 1) / nthreads)
+                                 : std::numeric_limits<std::size_t>::max();
+
+        for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+        {
+            auto const n = particles[ibox].icell_x.size();
+            for (std::size_t first = 0; first < n; first += chunk)
+            {
+                DepositTask task{ibox, first, std::min(n, first + chunk)};
+                if (first > 0)
+                {
+                    task.scratch = scratch.size();
+                    scratch_of_box[ibox].push_back(scratch.size());
+                    auto const& box = boxes[ibox];
+                    scratch.emplace_back(box.lower, box.upper, box.ghosts);
+                }
+                tasks.push_back(task);
+            }
+        }
+
+        std::stable_sort(std::begin(tasks), std::end(tasks),
+                         [](auto const& a, auto const& b) { return a.size() > b.size(); });
+        for (std::size_t i = 0; i < tasks.size(); ++i)
+            queues[i % nthreads].tasks.push_back(i);
+
+        for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+            if (scratch_of_box[ibox].size())
+                split_boxes.push_back(ibox);
+    }
+
+    auto run(std::vector<ParticleArray<dim>> const& particles, std::vector<ThreadBox<dim>>& boxes)
+    {
+        for (std::size_t t = 0; t < nthreads; ++t)
+            queues[t].next = 0, queues[t].end = queues[t].tasks.size();
+
+        std::vector<ThreadTimes> times(nthreads);
+        auto const start = omp_get_wtime();
+#pragma omp parallel num_threads(nthreads)
+        {
+            auto const t = static_cast<std::size_t>(omp_get_thread_num());
+            auto& mine   = times[t];
+
+            std::size_t itask;
+            bool stolen;
+            while (pop(t, itask, stolen))
+            {
+                auto const begin  = omp_get_wtime();
+                auto const& task  = tasks[itask];
+                auto& destination = task.scratch == DepositTask::no_scratch ? boxes[task.ibox]
+                                                                            : scratch[task.scratch];
+                if (task.scratch != DepositTask::no_scratch)
+                    zero(destination);
+                deposit<dim>(particles[task.ibox], destination, task.first, task.last);
+                mine.busy += omp_get_wtime() - begin;
+                mine.tasks += 1;
+                mine.stolen += stolen;
+            }
+
+#pragma omp barrier
+            auto const begin = omp_get_wtime();
+#pragma omp for schedule(dynamic, 1) nowait
+            for (std::size_t i = 0; i < split_boxes.size(); ++i)
+            {
+                auto& box = boxes[split_boxes[i]];
+                for (auto const is : scratch_of_box[split_boxes[i]])
+                    add(scratch[is], box);
+            }
+            mine.busy += omp_get_wtime() - begin;
+        }
+        auto const wall = omp_get_wtime() - start;
+        for (auto& t : times)
+            t.idle = wall - t.busy;
+        return times;
+    }
+
+    auto const& deposit_tasks() const { return tasks; }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::vector<std::size_t> tasks; // indices into tasks, largest first
+        std::size_t next = 0, end = 0;  // [next, end) is left to run
+    };
+
+    // own queue from the front, then the other queues from the back
+    bool pop(std::size_t t, std::size_t& itask, bool& stolen)
+    {
+        for (std::size_t i = 0; i < nthreads; ++i)
+        {
+            auto& queue = queues[(t + i) % nthreads];
+            std::lock_guard<std::mutex> lock{queue.mutex};
+            if (queue.next == queue.end)
+                continue;
+            stolen = i > 0;
+            itask  = stolen ? queue.tasks[--queue.end] : queue.tasks[queue.next++];
+            return true;
+        }
+        return false;
+    }
+
+    // same shaped fields
+    static void add(ThreadBox<dim> const& from, ThreadBox<dim>& to)
+    {
+        for (std::size_t i = 0; i < to.field_size(); ++i)
+        {
+            to.density[i] += from.density[i];
+            to.fluxx[i] += from.fluxx[i];
+            to.fluxy[i] += from.fluxy[i];
+            to.fluxz[i] += from.fluxz[i];
+        }
+    }
+
+    std::size_t nthreads;
+    std::vector<DepositTask> tasks;
+    std::deque<Queue> queues; // mutexes do not move
+    std::vector<ThreadBox<dim>> scratch;
+    std::vector<std::vector<std::size_t>> scratch_of_box;
+    std::vector<std::size_t> split_boxes;
+};
+
+
+// the plain omp loops over the threadboxes with the same busy/idle accounting
+//  dynamic : schedule(dynamic, 1) instead of static, in box order
+template<std::size_t dim>
+auto deposit_omp_for(std::vector<ParticleArray<dim>> const& particles,
+                     std::vector<ThreadBox<dim>>& boxes, std::size_t nthreads, bool dynamic)
+{
+    std::vector<ThreadTimes> times(nthreads);
+    auto const start = omp_get_wtime();
+#pragma omp parallel num_threads(nthreads)
+    {
+        auto& mine = times[omp_get_thread_num()];
+        auto const one = [&](std::size_t ibox) {
+            auto const begin = omp_get_wtime();
+            deposit<dim>(particles[ibox], boxes[ibox]);
+            mine.busy += omp_get_wtime() - begin;
+            mine.tasks += 1;
+        };
+        if (dynamic)
+        {
+#pragma omp for schedule(dynamic, 1)
+            for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+                one(ibox);
+        }
+        else
+        {
+#pragma omp for schedule(static)
+            for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+                one(ibox);
+        }
+    }
+    auto const wall = omp_get_wtime() - start;
+    for (auto& t : times)
+        t.idle = wall - t.busy;
+    return times;
+}
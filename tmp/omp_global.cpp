@@ -0,0 +1,100 @@
+#include "omp.hpp"
+
+// full parallel deposit into one domain field, compared to the sequential deposit
+//  colored : threadboxes deposit straight into the domain, 2^dim colour phases
+//  reduced : private threadbox fields, border nodes reduced by colour
+//  atomic  : straight into the domain with atomic adds
+//  copies  : one full domain copy per thread, summed after
+//  omp_global N TB [dim=2] [nppc=100] [repeat=10]
+
+
+template<std::size_t dim>
+double max_relative_difference(ThreadBox<dim> const& a, ThreadBox<dim> const& b)
+{
+    double diff = 0, norm = 0;
+    for (std::size_t i = 0; i < a.field_size(); ++i)
+    {
+        diff = std::max(diff, std::abs(a.density[i] - b.density[i]));
+        diff = std::max(diff, std::abs(a.fluxx[i] - b.fluxx[i]));
+        diff = std::max(diff, std::abs(a.fluxy[i] - b.fluxy[i]));
+        diff = std::max(diff, std::abs(a.fluxz[i] - b.fluxz[i]));
+        norm = std::max(norm, std::abs(b.density[i]));
+    }
+    return norm > 0 ? diff / norm : diff;
+}
+
+
+template<std::size_t dim>
+int run(std::size_t N, std::size_t TB, std::size_t nppc, std::size_t repeat)
+{
+    auto boxes     = make_threadboxes<dim>(N, TB);
+    auto particles = load_threadbox_particles<dim>(boxes, nppc);
+
+    std::array<std::size_t, dim> lower{}, upper;
+    for (std::size_t d = 0; d < dim; ++d)
+        upper[d] = boxes.back().upper[d];
+    ThreadBox<dim> expected{lower, upper}, domain{lower, upper};
+
+    std::vector<double> times(repeat);
+    for (std::size_t r = 0; r < repeat; ++r)
+    {
+        zero(expected);
+        auto start = omp_get_wtime();
+        for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+            deposit<dim>(particles[ibox], expected);
+        times[r] = omp_get_wtime() - start;
+    }
+    auto tseq = std::accumulate(std::begin(times), std::end(times), 0.) / repeat;
+    std::cout << "sequential time : " << tseq << "\n";
+
+    int const maxthreads = omp_get_max_threads(); // OMP_NUM_THREADS or the core count
+    std::vector<ThreadBox<dim>> copies(maxthreads, ThreadBox<dim>{lower, upper});
+
+    auto modes = {"colored", "reduced", "atomic", "copies"};
+    bool ok    = true;
+    std::cout << "mode,threads,time,speedup,max_rel_diff\n";
+    for (std::string mode : modes)
+    {
+        for (int nthreads = 1; nthreads <= maxthreads; ++nthreads)
+        {
+            omp_set_num_threads(nthreads);
+            for (std::size_t r = 0; r < repeat; ++r)
+            {
+                auto start = omp_get_wtime();
+                zero(domain);
+                if (mode == "colored")
+                    deposit_global_colored(particles, boxes, TB, domain);
+                else if (mode == "reduced")
+                    deposit_global_reduced(particles, boxes, TB, domain);
+                else if (mode == "atomic")
+                    deposit_global_atomic(particles, domain);
+                else
+                    deposit_global_copies(particles, copies, domain);
+                times[r] = omp_get_wtime() - start;
+            }
+            auto t    = std::accumulate(std::begin(times), std::end(times), 0.) / repeat;
+            auto diff = max_relative_difference(domain, expected);
+            ok &= diff < 1e-12;
+            std::cout << mode << "," << nthreads << "," << t << "," << tseq / t << "," << diff
+                      << "\n";
+        }
+    }
+    std::cout << "matches sequential : " << (ok ? "ok" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
+
+
+int main(int argc, char** argv)
+{
+    std::size_t N      = std::atoi(argv[1]);
+    std::size_t TB     = std::atoi(argv[2]);
+    std::size_t dim    = argc > 3 ? std::atoi(argv[3]) : 2;
+    std::size_t nppc   = argc > 4 ? std::atoi(argv[4]) : 100;
+    std::size_t repeat = argc > 5 ? std::atoi(argv[5]) : 10;
+
+    if (dim == 1)
+        return run<1>(N, TB, nppc, repeat);
+    if (dim == 3)
+        return run<3>(N, TB, nppc, repeat);
+    return run<2>(N, TB, nppc, repeat);
+}
@@ -0,0 +1,149 @@
+#include "omp.hpp"
+
+// field to particle interpolation of E and B, first and second order, particles/s per thread over
+//  the threadboxes of an N^dim domain, with 1 and the max threads
+//  sorted   : interpolate_sorted, cell ordered particles, the window loaded once per cell
+//  unsorted : interpolate_unsorted without prefetch, random particles
+//  prefetch : interpolate, random particles, the GatherConfig persisted by prefetch/cpp
+//             (gather.conf or GATHER_CONFIG) or the default of interpolate without one
+//  the three must agree on the same particles, checked against interpolate_unsorted
+//  omp_interp [dim=0 (all)] [N=256, 32 in 3D] [TB=16, 8 in 3D] [nppc=20] [repeat=5]
+//  1D runs N^2 cells in boxes of TB^2, the same particle count as 2D
+
+
+template<typename Interpolate>
+double time_interpolate(Interpolate&& interpolate, std::size_t repeat)
+{
+    std::vector<double> times(repeat);
+    for (std::size_t r = 0; r < repeat; ++r)
+    {
+        auto start = omp_get_wtime();
+        interpolate();
+        times[r] = omp_get_wtime() - start;
+    }
+    return *std::min_element(std::begin(times), std::end(times));
+}
+
+double max_difference(ParticleEM const& a, ParticleEM const& b)
+{
+    double diff     = 0;
+    auto const in_a = a.components();
+    auto const in_b = b.components();
+    for (std::size_t m = 0; m < 6; ++m)
+        for (std::size_t ip = 0; ip < in_a[m]->size(); ++ip)
+            diff = std::max(diff, std::abs((*in_a[m])[ip] - (*in_b[m])[ip]));
+    return diff;
+}
+
+
+template<std::size_t dim, std::size_t order>
+bool run_order(std::size_t N, std::size_t TB, std::size_t nppc, std::size_t repeat,
+               GatherConfig const& config, int maxthreads)
+{
+    std::vector<EMBox<dim>> fields;
+    for (auto const& box : make_threadboxes<dim>(N, TB))
+        fields.emplace_back(box.lower, box.upper, Shape<order>::ghosts);
+    for (auto& box : fields)
+    {
+        auto components = box.components();
+        for (std::size_t m = 0; m < 6; ++m)
+            for (std::size_t idx = 0; idx < box.field_size(); ++idx)
+                (*components[m])[idx] = std::sin(0.01 * idx) + 0.1 * m;
+    }
+
+    auto sorted   = load_threadbox_particles<dim>(fields, nppc, true);
+    auto unsorted = load_threadbox_particles<dim>(fields, nppc, false);
+    std::size_t n = 0;
+    std::vector<ParticleEM> em, reference;
+    for (auto const& particles : unsorted)
+    {
+        n += particles.icell_x.size();
+        em.emplace_back(particles.icell_x.size());
+        reference.emplace_back(particles.icell_x.size());
+    }
+    for (std::size_t ibox = 0; ibox < fields.size(); ++ibox)
+        interpolate_unsorted<dim, order>(unsorted[ibox], fields[ibox], reference[ibox]);
+
+    // the sorted particles differ from the unsorted ones, checked against themselves unsorted
+    std::vector<ParticleEM> sorted_reference;
+    for (std::size_t ibox = 0; ibox < fields.size(); ++ibox)
+    {
+        sorted_reference.emplace_back(sorted[ibox].icell_x.size());
+        interpolate_unsorted<dim, order>(sorted[ibox], fields[ibox], sorted_reference[ibox]);
+    }
+
+    bool ok = true;
+    auto run = [&](std::string const& input, auto const& particles, auto const& expected,
+                   auto&& interpolate) {
+        for (int threads : {1, maxthreads})
+        {
+            omp_set_num_threads(threads);
+            auto t = time_interpolate(
+                [&]() {
+#pragma omp parallel for schedule(dynamic, 1)
+                    for (std::size_t ibox = 0; ibox < fields.size(); ++ibox)
+                        interpolate(particles[ibox], fields[ibox], em[ibox]);
+                },
+                repeat);
+            double diff = 0;
+            for (std::size_t ibox = 0; ibox < fields.size(); ++ibox)
+                diff = std::max(diff, max_difference(em[ibox], expected[ibox]));
+            ok &= diff < 1e-12;
+            std::cout << dim << "," << order << "," << input << "," << threads << ","
+                      << n / t / threads << "," << diff << "\n";
+            if (maxthreads == 1)
+                break;
+        }
+    };
+
+    run("sorted", sorted, sorted_reference, [](auto const& p, auto const& f, auto& e) {
+        interpolate_sorted<dim, order>(p, f, e);
+    });
+    run("unsorted", unsorted, reference, [](auto const& p, auto const& f, auto& e) {
+        interpolate_unsorted<dim, order>(p, f, e);
+    });
+    run("prefetch", unsorted, reference, [&](auto const& p, auto const& f, auto& e) {
+        interpolate<dim, order>(p, f, e, config);
+    });
+    omp_set_num_threads(maxthreads);
+    return ok;
+}
+
+template<std::size_t dim>
+bool run(std::size_t N, std::size_t TB, std::size_t nppc, std::size_t repeat,
+         GatherConfig const& config, int maxthreads)
+{
+    bool ok = run_order<dim, 1>(N, TB, nppc, repeat, config, maxthreads);
+    return run_order<dim, 2>(N, TB, nppc, repeat, config, maxthreads) and ok;
+}
+
+
+int main(int argc, char** argv)
+{
+    std::size_t dim      = argc > 1 ? std::atoi(argv[1]) : 0;
+    std::size_t N        = argc > 2 ? std::atoi(argv[2]) : 0;
+    std::size_t TB       = argc > 3 ? std::atoi(argv[3]) : 0;
+    std::size_t nppc     = argc > 4 ? std::atoi(argv[4]) : 20;
+    std::size_t repeat   = argc > 5 ? std::atoi(argv[5]) : 5;
+    int const maxthreads = omp_get_max_threads();
+    auto const config    = load_gather_config().value_or(GatherConfig{8, 3, -1, 1});
+
+    std::cout << "prefetch config : " << config << "\n";
+    std::cout << "dim,order,input,threads,particles_per_s_per_thread,max_diff\n";
+    bool ok = true;
+    for (std::size_t d : {1, 2, 3})
+    {
+        if (dim != 0 and dim != d)
+            continue;
+        auto n  = N ? N : (d == 3 ? 32 : 256);
+        auto tb = TB ? TB : (d == 3 ? 8 : 16);
+        if (d == 1)
+            ok &= run<1>(n * n, tb * tb, nppc, repeat, config, maxthreads);
+        if (d == 2)
+            ok &= run<2>(n, tb, nppc, repeat, config, maxthreads);
+        if (d == 3)
+            ok &= run<3>(n, tb, nppc, repeat, config, maxthreads);
+    }
+    std::cout << "paths agree : " << (ok ? "ok" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include "omp.hpp"
+
+// particle loading, the serial mt19937 loaders against the parallel Philox ones
+//  domain    : one array for the whole domain, threads share the array
+//  boxes     : one array per threadbox, threads take whole boxes
+//  identical : same bits as the parallel loader with one thread
+//  omp_load N TB [dim=2] [nppc=1000]
+
+
+template<std::size_t dim>
+bool same(std::vector<ParticleArray<dim>> const& a, std::vector<ParticleArray<dim>> const& b)
+{
+    bool ok = a.size() == b.size();
+    for (std::size_t i = 0; ok and i < a.size(); ++i)
+    {
+        ok = a[i].icell_x == b[i].icell_x and a[i].delta_x == b[i].delta_x
+             and a[i].v_x == b[i].v_x and a[i].v_y == b[i].v_y and a[i].v_z == b[i].v_z;
+        if constexpr (dim >= 2)
+            ok = ok and a[i].icell_y == b[i].icell_y and a[i].delta_y == b[i].delta_y;
+        if constexpr (dim == 3)
+            ok = ok and a[i].icell_z == b[i].icell_z and a[i].delta_z == b[i].delta_z;
+    }
+    return ok;
+}
+
+
+template<std::size_t dim>
+int run(std::size_t N, std::size_t TB, std::size_t nppc)
+{
+    std::array<std::size_t, dim> lower{}, upper;
+    upper.fill(N - 1);
+    Box<dim> domain{lower, upper};
+    auto boxes = make_threadboxes<dim>(N, TB);
+    auto n     = static_cast<double>(nppc * domain.size());
+
+    auto start   = omp_get_wtime();
+    auto serial  = load_particles_ordered(domain, nppc);
+    auto tserial = omp_get_wtime() - start;
+    std::cout << "serial mt19937 : " << n / tserial * 1e-6 << " Mparticles/s\n";
+
+    int const maxthreads = omp_get_max_threads(); // OMP_NUM_THREADS or the core count
+    std::vector<ParticleArray<dim>> domain_reference, boxes_reference;
+
+    bool ok = true;
+    std::cout << "layout,threads,Mparticles_per_s,speedup_vs_serial,identical\n";
+    for (std::string layout : {"domain", "boxes"})
+    {
+        for (int nthreads = 1; nthreads <= maxthreads; ++nthreads)
+        {
+            omp_set_num_threads(nthreads);
+            std::vector<ParticleArray<dim>> particles;
+            start = omp_get_wtime();
+            if (layout == "domain")
+                particles.push_back(load_particles_ordered_parallel(domain, nppc, 0));
+            else
+                particles = load_threadbox_particles<dim>(boxes, nppc);
+            auto t = omp_get_wtime() - start;
+
+            auto& reference = layout == "domain" ? domain_reference : boxes_reference;
+            if (nthreads == 1)
+                reference = particles;
+            auto identical = same(particles, reference);
+            ok &= identical;
+            std::cout << layout << "," << nthreads << "," << n / t * 1e-6 << "," << tserial / t
+                      << "," << identical << "\n";
+        }
+    }
+    std::cout << "identical for all thread counts : " << (ok ? "ok" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
+
+
+int main(int argc, char** argv)
+{
+    std::size_t N    = std::atoi(argv[1]);
+    std::size_t TB   = std::atoi(argv[2]);
+    std::size_t dim  = argc > 3 ? std::atoi(argv[3]) : 2;
+    std::size_t nppc = argc > 4 ? std::atoi(argv[4]) : 1000;
+
+    if (dim == 1)
+        return run<1>(N, TB, nppc);
+    if (dim == 3)
+        return run<3>(N, TB, nppc);
+    return run<2>(N, TB, nppc);
+}
@@ -0,0 +1,93 @@
+#include "omp.hpp"
+
+// fused moment deposit into the interleaved MomentBox against the four separate ThreadBox
+//  fields, for cell ordered and random particles
+//  separate : deposit<dim, order>, hand written kernels at first order
+//  shaped   : deposit_shaped<dim, order>, same stencil code as the fused deposit
+//  fused    : deposit_moments<dim, order>
+//  omp_moments [dim=2] [N=50] [nppc=100] [repeat=10]
+
+
+template<typename Deposit>
+double time_deposit(Deposit&& deposit, std::size_t repeat)
+{
+    std::vector<double> times(repeat);
+    for (std::size_t r = 0; r < repeat; ++r)
+    {
+        auto start = omp_get_wtime();
+        deposit();
+        times[r] = omp_get_wtime() - start;
+    }
+    return std::accumulate(std::begin(times), std::end(times), 0.) / repeat;
+}
+
+template<std::size_t dim>
+double max_difference(ThreadBox<dim> const& a, MomentBox<dim> const& b)
+{
+    double diff = 0;
+    for (std::size_t i = 0; i < a.field_size(); ++i)
+    {
+        diff = std::max(diff, std::abs(a.density[i] - density(b)[i]));
+        diff = std::max(diff, std::abs(a.fluxx[i] - fluxx(b)[i]));
+        diff = std::max(diff, std::abs(a.fluxy[i] - fluxy(b)[i]));
+        diff = std::max(diff, std::abs(a.fluxz[i] - fluxz(b)[i]));
+    }
+    return diff;
+}
+
+
+template<std::size_t dim, std::size_t order>
+void run_order(Box<dim> const& domain, std::size_t nppc, std::size_t repeat)
+{
+    constexpr auto ghosts = Shape<order>::ghosts;
+    for (auto ordered : {true, false})
+    {
+        auto particles = ordered ? load_particles_ordered(domain, nppc)
+                                 : load_particles_random(domain, nppc);
+        ThreadBox<dim> separate{domain.lower, domain.upper, ghosts};
+        ThreadBox<dim> shaped{domain.lower, domain.upper, ghosts};
+        MomentBox<dim> fused{domain.lower, domain.upper, ghosts};
+
+        auto tseparate
+            = time_deposit([&]() { deposit<dim, order>(particles, separate); }, repeat);
+        auto tshaped
+            = time_deposit([&]() { deposit_shaped<dim, order>(particles, shaped); }, repeat);
+        auto tfused
+            = time_deposit([&]() { deposit_moments<dim, order>(particles, fused); }, repeat);
+
+        auto n = static_cast<double>(particles.icell_x.size());
+        std::cout << dim << "," << order << "," << (ordered ? "sorted" : "unsorted") << ","
+                  << tseparate * 1e9 / n << "," << tshaped * 1e9 / n << "," << tfused * 1e9 / n
+                  << "," << tseparate / tfused << "," << max_difference(separate, fused) << "\n";
+    }
+}
+
+template<std::size_t dim>
+int run(std::size_t N, std::size_t nppc, std::size_t repeat)
+{
+    std::array<std::size_t, dim> lower{}, upper;
+    upper.fill(N - 1);
+    Box<dim> domain{lower, upper};
+
+    std::cout << "dim,order,input,separate_ns_per_particle,shaped_ns_per_particle,"
+                 "fused_ns_per_particle,speedup,max_diff\n";
+    run_order<dim, 1>(domain, nppc, repeat);
+    run_order<dim, 2>(domain, nppc, repeat);
+    run_order<dim, 3>(domain, nppc, repeat);
+    return 0;
+}
+
+
+int main(int argc, char** argv)
+{
+    std::size_t dim    = argc > 1 ? std::atoi(argv[1]) : 2;
+    std::size_t N      = argc > 2 ? std::atoi(argv[2]) : 50;
+    std::size_t nppc   = argc > 3 ? std::atoi(argv[3]) : 100;
+    std::size_t repeat = argc > 4 ? std::atoi(argv[4]) : 10;
+
+    if (dim == 1)
+        return run<1>(N, nppc, repeat);
+    if (dim == 3)
+        return run<3>(N, nppc, repeat);
+    return run<2>(N, nppc, repeat);
+}
@@ -0,0 +1,80 @@
+#include "omp.hpp"
+
+// cost per particle of deposit<dim, order> against thread count
+//  higher orders touch (order + 1)^dim nodes per particle, so the flops per byte of particle
+//  data grow with order and the kernels can scale differently
+//  omp_order N TB [dim=2] [nppc=100] [repeat=100]
+
+
+template<std::size_t dim, std::size_t order>
+void bench_order(std::vector<ParticleArray<dim>> const& particles, std::size_t N, std::size_t TB,
+                 std::size_t repeat, std::ofstream& csv)
+{
+    auto boxes = make_threadboxes<dim>(N, TB, Shape<order>::ghosts);
+
+    std::size_t nparticles = 0;
+    for (auto const& array : particles)
+        nparticles += array.icell_x.size();
+
+    std::size_t nodes = 1;
+    for (std::size_t i = 0; i < dim; ++i)
+        nodes *= order + 1;
+
+    double t1            = 0;
+    int const maxthreads = omp_get_max_threads(); // OMP_NUM_THREADS or the core count
+    for (int nthreads = 1; nthreads <= maxthreads; ++nthreads)
+    {
+        omp_set_num_threads(nthreads);
+        std::vector<double> times(repeat);
+        for (std::size_t r = 0; r < repeat; ++r)
+        {
+            auto start = omp_get_wtime();
+#pragma omp parallel for
+            for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+            {
+                deposit<dim, order>(particles[ibox], boxes[ibox]);
+            }
+            times[r] = omp_get_wtime() - start;
+        }
+        auto t = std::accumulate(std::begin(times), std::end(times), 0.) / repeat;
+        if (nthreads == 1)
+            t1 = t;
+        auto ns_per_particle = t * 1e9 / nparticles;
+        std::cout << "order " << order << " threads " << nthreads << " : " << ns_per_particle
+                  << " ns/particle, speedup " << t1 / t << "\n";
+        csv << dim << "," << order << "," << nodes << "," << nthreads << "," << ns_per_particle
+            << "," << t1 / t << "\n";
+    }
+}
+
+
+template<std::size_t dim>
+void run(std::size_t N, std::size_t TB, std::size_t nppc, std::size_t repeat)
+{
+    auto particles = load_threadbox_particles<dim>(make_threadboxes<dim>(N, TB), nppc);
+
+    std::ofstream csv{"order_" + std::to_string(dim) + "d_" + std::to_string(N) + "_"
+                      + std::to_string(TB) + ".csv"};
+    csv << "dim,order,nodes_per_particle,threads,ns_per_particle,speedup\n";
+    bench_order<dim, 1>(particles, N, TB, repeat, csv);
+    bench_order<dim, 2>(particles, N, TB, repeat, csv);
+    bench_order<dim, 3>(particles, N, TB, repeat, csv);
+}
+
+
+int main(int argc, char** argv)
+{
+    std::size_t N      = std::atoi(argv[1]);
+    std::size_t TB     = std::atoi(argv[2]);
+    std::size_t dim    = argc > 3 ? std::atoi(argv[3]) : 2;
+    std::size_t nppc   = argc > 4 ? std::atoi(argv[4]) : 100;
+    std::size_t repeat = argc > 5 ? std::atoi(argv[5]) : 100;
+
+    if (dim == 1)
+        run<1>(N, TB, nppc, repeat);
+    else if (dim == 3)
+        run<3>(N, TB, nppc, repeat);
+    else
+        run<2>(N, TB, nppc, repeat);
+    return 0;
+}
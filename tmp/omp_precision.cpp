@@ -0,0 +1,111 @@
+#include "omp.hpp"
+
+// storage (particle deltas and velocities) and accumulation (fields) precision of the deposit
+//  every combination of float and double against the all double deposit of the same particles
+//  bench    : parallel deposit over the threadboxes, ns per particle and max deviation
+//  validate : one deposit per combination, max deviation only
+//  omp_precision N TB [dim=2] [nppc=100] [repeat=10] [bench|validate]
+
+
+template<std::size_t dim, std::size_t order, typename Real, typename Acc>
+void run_combination(std::vector<ParticleArray<dim>> const& particles,
+                     std::vector<ThreadBox<dim>> const& reference, std::size_t repeat,
+                     double tref, std::string const& mode)
+{
+    std::vector<ParticleArray<dim, Real>> stored;
+    for (auto const& p : particles)
+        stored.push_back(with_precision<Real>(p));
+    std::vector<ThreadBox<dim, Acc>> boxes;
+    for (auto const& box : reference)
+        boxes.emplace_back(box.lower, box.upper, box.ghosts);
+
+    double t = 0, nparticles = 0;
+    for (auto const& p : particles)
+        nparticles += p.icell_x.size();
+
+    if (mode == "validate")
+    {
+        for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+            deposit<dim, order>(stored[ibox], boxes[ibox]);
+    }
+    else
+    {
+        for (std::size_t r = 0; r < repeat; ++r)
+        {
+            auto start = omp_get_wtime();
+#pragma omp parallel for
+            for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+                deposit<dim, order>(stored[ibox], boxes[ibox]);
+            t += omp_get_wtime() - start;
+        }
+        t /= repeat;
+    }
+
+    // the reference holds repeat deposits in bench mode, one in validate mode
+    double deviation = 0;
+    for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+        deviation = std::max(deviation, max_deviation(boxes[ibox], reference[ibox]));
+
+    auto name = [](auto x) { return sizeof(x) == sizeof(float) ? "float" : "double"; };
+    std::cout << dim << "," << order << "," << name(Real{}) << "," << name(Acc{}) << ","
+              << particle_bytes<dim, Real> << ",";
+    if (mode == "validate")
+        std::cout << ",,";
+    else
+        std::cout << t / nparticles * 1e9 << "," << tref / t << ",";
+    std::cout << deviation << "\n";
+}
+
+template<std::size_t dim, std::size_t order>
+void run_order(std::size_t N, std::size_t TB, std::size_t nppc, std::size_t repeat,
+               std::string const& mode)
+{
+    auto boxes     = make_threadboxes<dim>(N, TB, Shape<order>::ghosts);
+    auto particles = load_threadbox_particles<dim>(boxes, nppc);
+
+    // all double reference, timed like the combinations
+    double tref = 0;
+    for (std::size_t r = 0; r < (mode == "validate" ? 1 : repeat); ++r)
+    {
+        auto start = omp_get_wtime();
+#pragma omp parallel for
+        for (std::size_t ibox = 0; ibox < boxes.size(); ++ibox)
+            deposit<dim, order>(particles[ibox], boxes[ibox]);
+        tref += omp_get_wtime() - start;
+    }
+    tref /= repeat;
+
+    run_combination<dim, order, double, double>(particles, boxes, repeat, tref, mode);
+    run_combination<dim, order, float, double>(particles, boxes, repeat, tref, mode);
+    run_combination<dim, order, double, float>(particles, boxes, repeat, tref, mode);
+    run_combination<dim, order, float, float>(particles, boxes, repeat, tref, mode);
+}
+
+template<std::size_t dim>
+int run(std::size_t N, std::size_t TB, std::size_t nppc, std::size_t repeat,
+        std::string const& mode)
+{
+    std::cout << "dim,order,storage,accumulation,particle_bytes,ns_per_particle,speedup,"
+                 "max_deviation\n";
+    run_order<dim, 1>(N, TB, nppc, repeat, mode);
+    run_order<dim, 2>(N, TB, nppc, repeat, mode);
+    run_order<dim, 3>(N, TB, nppc, repeat, mode);
+    return 0;
+}
+
+
+int main(int argc, char** argv)
+{
+    std::size_t N      = std::atoi(argv[1]);
+    std::size_t TB     = std::atoi(argv[2]);
+    std::size_t dim    = argc > 3 ? std::atoi(argv[3]) : 2;
+    std::size_t nppc   = argc > 4 ? std::atoi(argv[4]) : 100;
+    std::size_t repeat = argc > 5 ? std::atoi(argv[5]) : 10;
+    std::string mode   = argc > 6 ? argv[6] : "bench";
+
+    if (dim == 1)
+        return run<1>(N, TB, nppc, repeat, mode);
+    if (dim == 3)
+        return run<3>(N, TB, nppc, repeat, mode);
+    return run<2>(N, TB, nppc, repeat, mode);
+}
@@ -0,0 +1,151 @@
+#include "omp.hpp"
+
+// threadbox scheduling for non uniform plasma : particles per cell follow a gaussian blob in
+//  the middle of the domain, so box costs differ by orders of magnitude
+//  static   : #pragma omp for, what omp.cpp does
+//  dynamic  : schedule(dynamic, 1) in box order
+//  stealing : DepositScheduler, longest first with work stealing and oversized boxes split
+//  nosplit  : DepositScheduler without splitting
+//  per thread busy/idle is printed for the largest thread count : idle threads with a long
+//  busiest thread is load imbalance, busy threads without speedup is bandwidth saturation
+//  omp_sched N TB [dim=2] [peak_nppc=1000] [repeat=10]
+
+
+// particles per cell at the centre of the box
+template<std::size_t dim>
+std::size_t blob_nppc(Box<dim> const& box, std::size_t N, std::size_t peak)
+{
+    double const sigma = N / 8.;
+    double r2          = 0;
+    for (std::size_t d = 0; d < dim; ++d)
+    {
+        auto x = (box.lower[d] + box.upper[d] + 1) / 2. - N / 2.;
+        r2 += x * x;
+    }
+    return std::max<std::size_t>(1, peak * std::exp(-r2 / (2 * sigma * sigma)));
+}
+
+template<std::size_t dim>
+double max_relative_difference(std::vector<ThreadBox<dim>> const& a,
+                               std::vector<ThreadBox<dim>> const& b)
+{
+    double diff = 0, norm = 0;
+    for (std::size_t ibox = 0; ibox < a.size(); ++ibox)
+        for (std::size_t i = 0; i < a[ibox].field_size(); ++i)
+        {
+            diff = std::max(diff, std::abs(a[ibox].density[i] - b[ibox].density[i]));
+            diff = std::max(diff, std::abs(a[ibox].fluxx[i] - b[ibox].fluxx[i]));
+            norm = std::max(norm, std::abs(b[ibox].density[i]));
+        }
+    return norm > 0 ? diff / norm : diff;
+}
+
+
+template<std::size_t dim>
+int run(std::size_t N, std::size_t TB, std::size_t peak, std::size_t repeat)
+{
+    auto expected = make_threadboxes<dim>(N, TB);
+    std::vector<ParticleArray<dim>> particles;
+    std::size_t total = 0, largest = 0;
+    for (auto const& box : expected)
+    {
+        particles.push_back(load_particles_ordered(box, blob_nppc(box, N, peak)));
+        total += particles.back().icell_x.size();
+        largest = std::max(largest, particles.back().icell_x.size());
+    }
+    std::cout << expected.size() << " threadboxes, " << total << " particles, largest box "
+              << largest << "\n";
+
+    std::vector<double> times(repeat);
+    for (std::size_t r = 0; r < repeat; ++r)
+    {
+        for (auto& box : expected)
+            zero(box);
+        auto start = omp_get_wtime();
+        for (std::size_t ibox = 0; ibox < expected.size(); ++ibox)
+            deposit<dim>(particles[ibox], expected[ibox]);
+        times[r] = omp_get_wtime() - start;
+    }
+    auto tseq = std::accumulate(std::begin(times), std::end(times), 0.) / repeat;
+    std::cout << "sequential time : " << tseq << "\n";
+
+    int const maxthreads = omp_get_max_threads(); // OMP_NUM_THREADS or the core count
+    auto boxes           = expected;
+
+    auto modes = {"static", "dynamic", "stealing", "nosplit"};
+    bool ok    = true;
+    std::vector<std::pair<std::string, std::vector<ThreadTimes>>> last;
+    std::cout << "mode,threads,time,speedup,max_rel_diff,busiest/mean_busy,idle_fraction\n";
+    for (std::string mode : modes)
+    {
+        for (int nthreads = 1; nthreads <= maxthreads; ++nthreads)
+        {
+            std::unique_ptr<DepositScheduler<dim>> scheduler;
+            if (mode == "stealing" or mode == "nosplit")
+                scheduler = std::make_unique<DepositScheduler<dim>>(particles, boxes, nthreads,
+                                                                    mode == "stealing");
+
+            std::vector<ThreadTimes> sum(nthreads);
+            for (std::size_t r = 0; r < repeat; ++r)
+            {
+                for (auto& box : boxes)
+                    zero(box);
+                auto start   = omp_get_wtime();
+                auto threads = scheduler ? scheduler->run(particles, boxes)
+                                         : deposit_omp_for(particles, boxes, nthreads,
+                                                           mode == "dynamic");
+                times[r]     = omp_get_wtime() - start;
+                for (int t = 0; t < nthreads; ++t)
+                {
+                    sum[t].busy += threads[t].busy / repeat;
+                    sum[t].idle += threads[t].idle / repeat;
+                    sum[t].tasks += threads[t].tasks;
+                    sum[t].stolen += threads[t].stolen;
+                }
+            }
+            double busiest = 0, busy = 0, idle = 0;
+            for (auto const& t : sum)
+            {
+                busiest = std::max(busiest, t.busy);
+                busy += t.busy;
+                idle += t.idle;
+            }
+
+            auto t    = std::accumulate(std::begin(times), std::end(times), 0.) / repeat;
+            auto diff = max_relative_difference(boxes, expected);
+            ok &= diff < 1e-12;
+            std::cout << mode << "," << nthreads << "," << t << "," << tseq / t << "," << diff
+                      << "," << busiest / (busy / nthreads) << "," << idle / (busy + idle)
+                      << "\n";
+            if (nthreads == maxthreads)
+                last.emplace_back(mode, sum);
+        }
+    }
+
+    std::cout << "\nper thread with " << maxthreads << " threads\n";
+    std::cout << "mode,thread,busy,idle,tasks,stolen\n";
+    for (auto const& [mode, threads] : last)
+        for (std::size_t t = 0; t < threads.size(); ++t)
+            std::cout << mode << "," << t << "," << threads[t].busy << "," << threads[t].idle
+                      << "," << threads[t].tasks / repeat << "," << threads[t].stolen / repeat
+                      << "\n";
+
+    std::cout << "matches sequential : " << (ok ? "ok" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
+
+
+int main(int argc, char** argv)
+{
+    std::size_t N      = std::atoi(argv[1]);
+    std::size_t TB     = std::atoi(argv[2]);
+    std::size_t dim    = argc > 3 ? std::atoi(argv[3]) : 2;
+    std::size_t peak   = argc > 4 ? std::atoi(argv[4]) : 1000;
+    std::size_t repeat = argc > 5 ? std::atoi(argv[5]) : 10;
+
+    if (dim == 1)
+        return run<1>(N, TB, peak, repeat);
+    if (dim == 3)
+        return run<3>(N, TB, peak, repeat);
+    return run<2>(N, TB, peak, repeat);
+}
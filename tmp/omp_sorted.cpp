@@ -0,0 +1,59 @@
+#include "omp.hpp"
+
+// deposit_sorted against deposit<2> for cell sorted particles, and the unsorted fallback
+//  omp_sorted [N=50] [repeat=10]
+
+
+template<typename Deposit>
+double time_deposit(Deposit&& deposit, std::size_t repeat)
+{
+    std::vector<double> times(repeat);
+    for (std::size_t r = 0; r < repeat; ++r)
+    {
+        auto start = omp_get_wtime();
+        deposit();
+        times[r] = omp_get_wtime() - start;
+    }
+    return std::accumulate(std::begin(times), std::end(times), 0.) / repeat;
+}
+
+double max_difference(ThreadBox<2> const& a, ThreadBox<2> const& b)
+{
+    double diff = 0;
+    for (std::size_t i = 0; i < a.density.size(); ++i)
+    {
+        diff = std::max(diff, std::abs(a.density[i] - b.density[i]));
+        diff = std::max(diff, std::abs(a.fluxx[i] - b.fluxx[i]));
+        diff = std::max(diff, std::abs(a.fluxy[i] - b.fluxy[i]));
+        diff = std::max(diff, std::abs(a.fluxz[i] - b.fluxz[i]));
+    }
+    return diff;
+}
+
+
+int main(int argc, char** argv)
+{
+    std::size_t N      = argc > 1 ? std::atoi(argv[1]) : 50;
+    std::size_t repeat = argc > 2 ? std::atoi(argv[2]) : 10;
+    Box<2> domain{{0, 0}, {N - 1, N - 1}};
+
+    std::cout << "nppc,input,deposit_ns_per_particle,sorted_ns_per_particle,speedup,max_diff\n";
+    for (std::size_t nppc : {10, 30, 100, 300, 1000, 3000, 10000})
+    {
+        for (auto ordered : {true, false})
+        {
+            auto particles = ordered ? load_particles_ordered(domain, nppc)
+                                     : load_particles_random(domain, nppc);
+            ThreadBox<2> plain{domain.lower, domain.upper}, sorted{domain.lower, domain.upper};
+
+            auto tplain  = time_deposit([&]() { deposit<2>(particles, plain); }, repeat);
+            auto tsorted = time_deposit([&]() { deposit_sorted<2>(particles, sorted); }, repeat);
+
+            auto n = static_cast<double>(particles.icell_x.size());
+            std::cout << nppc << "," << (ordered ? "sorted" : "unsorted") << ","
+                      << tplain * 1e9 / n << "," << tsorted * 1e9 / n << "," << tplain / tsorted
+                      << "," << max_difference(plain, sorted) << "\n";
+        }
+    }
+    return 0;
+}
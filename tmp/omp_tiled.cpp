@@ -0,0 +1,135 @@
+#include "omp.hpp"
+
+// tiled field storage against the flat row-major ThreadBox, first order, one box of L^dim cells
+//  for L = 16 .. Lmax doubling, with particles in the order each layout wants and in random order
+//  flat  : deposit<dim> into ThreadBox, particles in cell order (load_particles_ordered)
+//  tiled : deposit_tiled into TiledBox (8x8 tiles in 2D, 4x4x4 in 3D), particles order_by_tile
+//  the win is expected once a row of the flat field no longer fits in L1/L2, small boxes fit
+//  whole and the index translation only costs
+//  omp_tiled [dim=2] [nppc=10] [Lmax=1024] [repeat=5]
+
+
+template<typename Deposit>
+double time_deposit(Deposit&& deposit, std::size_t repeat)
+{
+    std::vector<double> times(repeat);
+    for (std::size_t r = 0; r < repeat; ++r)
+    {
+        auto start = omp_get_wtime();
+        deposit();
+        times[r] = omp_get_wtime() - start;
+    }
+    return *std::min_element(std::begin(times), std::end(times));
+}
+
+template<std::size_t dim>
+void shuffle(ParticleArray<dim>& particles)
+{
+    std::mt19937_64 gen{1337};
+    auto const n = particles.icell_x.size();
+    std::vector<std::size_t> order(n);
+    std::iota(std::begin(order), std::end(order), std::size_t{0});
+    std::shuffle(std::begin(order), std::end(order), gen);
+
+    auto permute = [&](auto& v) {
+        auto const copy = v;
+        for (std::size_t ip = 0; ip < n; ++ip)
+            v[ip] = copy[order[ip]];
+    };
+    permute(particles.icell_x);
+    permute(particles.delta_x);
+    if constexpr (dim >= 2)
+    {
+        permute(particles.icell_y);
+        permute(particles.delta_y);
+    }
+    if constexpr (dim == 3)
+    {
+        permute(particles.icell_z);
+        permute(particles.delta_z);
+    }
+    permute(particles.v_x);
+    permute(particles.v_y);
+    permute(particles.v_z);
+}
+
+
+template<std::size_t dim>
+bool run_size(std::size_t L, std::size_t nppc, std::size_t repeat)
+{
+    std::array<std::size_t, dim> lower{}, upper;
+    upper.fill(L - 1);
+    Box<dim> domain{lower, upper};
+
+    auto ordered = load_particles_ordered(domain, nppc);
+    auto random  = ordered;
+    shuffle(random);
+    auto tiled_order = ordered;
+    TiledBox<dim> tiled{lower, upper};
+    order_by_tile(tiled_order, tiled);
+
+    ThreadBox<dim> flat{lower, upper}, check{lower, upper};
+    auto n    = static_cast<double>(ordered.icell_x.size());
+    auto tref = 0.;
+    bool ok   = true;
+
+    auto report = [&](std::string const& layout, std::string const& input, double t, double diff) {
+        if (tref == 0)
+            tref = t;
+        ok &= diff < 1e-12;
+        std::cout << dim << "," << L << "," << layout << "," << input << "," << t * 1e9 / n << ","
+                  << tref / t << "," << diff << "\n";
+    };
+
+    for (auto const* particles : {&ordered, &random})
+    {
+        auto t = time_deposit(
+            [&]() {
+                zero(flat);
+                deposit<dim>(*particles, flat);
+            },
+            repeat);
+        if (particles == &ordered)
+            check = flat;
+        report("flat", particles == &ordered ? "cell" : "random", t,
+               max_deviation(flat, check));
+    }
+    for (auto const* particles : {&tiled_order, &random})
+    {
+        auto t = time_deposit(
+            [&]() {
+                zero(tiled);
+                deposit_tiled(*particles, tiled);
+            },
+            repeat);
+        copy_to(tiled, flat);
+        report("tiled", particles == &random ? "random" : "tile", t, max_deviation(flat, check));
+    }
+    return ok;
+}
+
+template<std::size_t dim>
+int run(std::size_t nppc, std::size_t Lmax, std::size_t repeat)
+{
+    std::cout << "dim,L,layout,input,ns_per_particle,speedup,max_rel_diff\n";
+    bool ok = true;
+    for (std::size_t L = 16; L <= Lmax; L *= 2)
+        ok &= run_size<dim>(L, nppc, repeat);
+    std::cout << "tiled matches flat : " << (ok ? "ok" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
+
+
+int main(int argc, char** argv)
+{
+    std::size_t dim    = argc > 1 ? std::atoi(argv[1]) : 2;
+    std::size_t nppc   = argc > 2 ? std::atoi(argv[2]) : 10;
+    std::size_t Lmax   = argc > 3 ? std::atoi(argv[3]) : (dim == 3 ? 128 : 1024);
+    std::size_t repeat = argc > 4 ? std::atoi(argv[4]) : 5;
+
+    if (dim == 1)
+        return run<1>(nppc, Lmax, repeat);
+    if (dim == 3)
+        return run<3>(nppc, Lmax, repeat);
+    return run<2>(nppc, Lmax, repeat);
+}
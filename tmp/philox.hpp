@@ -0,0 +1,75 @@
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// counter based generator, Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as
+//  1, 2, 3", SC11) : the output is a pure function of (key, counter), so the numbers of any
+//  particle can be drawn by any thread in any order and loads are identical for any thread count
+
+
+struct Philox4x32
+{
+    using counter_t = std::array<std::uint32_t, 4>;
+    using key_t     = std::array<std::uint32_t, 2>;
+
+    static constexpr std::uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+    static constexpr std::uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+    static constexpr std::size_t rounds = 10;
+
+    static counter_t generate(counter_t c, key_t k)
+    {
+        for (std::size_t r = 0; r < rounds; ++r)
+        {
+            auto p0 = std::uint64_t{M0} * c[0];
+            auto p1 = std::uint64_t{M1} * c[2];
+            c       = {static_cast<std::uint32_t>(p1 >> 32) ^ c[1] ^ k[0],
+                 static_cast<std::uint32_t>(p1),
+                 static_cast<std::uint32_t>(p0 >> 32) ^ c[3] ^ k[1],
+                 static_cast<std::uint32_t>(p0)};
+            k[0] += W0;
+            k[1] += W1;
+        }
+        return c;
+    }
+};
+
+
+// [0, 1) with the 53 bits of a double
+inline double to_unit(std::uint32_t hi, std::uint32_t lo)
+{
+    auto bits = (std::uint64_t{hi} << 21) ^ (lo >> 11);
+    return static_cast<double>(bits) * 0x1.0p-53;
+}
+
+// the random numbers of one particle, index is its position in its array and stream tells its
+//  attributes (delta_x, v_x...) apart, key is (box, seed)
+struct ParticleRandom
+{
+    Philox4x32::key_t key;
+
+    auto draw(std::uint64_t index, std::uint32_t stream) const
+    {
+        return Philox4x32::generate({static_cast<std::uint32_t>(index),
+                                     static_cast<std::uint32_t>(index >> 32), stream, 0},
+                                    key);
+    }
+    double uniform(std::uint64_t index, std::uint32_t stream) const
+    {
+        auto r = draw(index, stream);
+        return to_unit(r[0], r[1]);
+    }
+    // three independent standard normals from one draw, Box-Muller on 32 bit uniforms in
+    //  (0, 1) so the tails stop at ~6.7 sigma
+    std::array<double, 3> normal3(std::uint64_t index, std::uint32_t stream) const
+    {
+        constexpr double two_pi = 6.283185307179586;
+        auto r                  = draw(index, stream);
+        auto u                  = [&](std::size_t i) { return (r[i] + 0.5) * 0x1.0p-32; };
+        auto radius0            = std::sqrt(-2. * std::log(u(0)));
+        auto radius1            = std::sqrt(-2. * std::log(u(2)));
+        auto angle0             = two_pi * u(1);
+        return {radius0 * std::cos(angle0), radius0 * std::sin(angle0),
+                radius1 * std::cos(two_pi * u(3))};
+    }
+};
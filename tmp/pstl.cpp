@@ -0,0 +1,118 @@
+
+// std::execution policies over the particle containers of soa.hpp and iter.hpp
+//  libstdc++ runs the parallel policies on TBB, so link it
+//   mkn build run -M pstl.cpp -O 3 -l -ltbb -a "-std=c++17"
+
+#include <execution>
+
+#include "soa.hpp"
+#include "iter.hpp"
+
+using box_t = Box<3>;
+
+auto random_cells(std::size_t n) {
+    std::mt19937_64 gen{1337};
+    std::uniform_int_distribution<int> dist{0, 99};
+    std::vector<std::array<int, 3>> cells(n);
+    for (auto& c : cells) c = {dist(gen), dist(gen), dist(gen)};
+    return cells;
+}
+
+template <typename Cells>
+auto as_sorted(Cells cells) {
+    std::sort(cells.begin(), cells.end());
+    return cells;
+}
+
+template <typename Policy, typename Particles>
+void run_particles(std::string const& name, Policy&& policy, Particles const& empty,
+                   std::vector<std::array<int, 3>> const& cells) {
+    CellFlattener<box_t> cf{box_t{{0, 0, 0}, {99, 99, 99}}};
+    auto const sorted_cells = as_sorted(cells);
+    auto particles = empty;
+    auto const reset = [&]() {
+        particles = empty;
+        for (auto const& c : cells) particles.push_back(c);
+    };
+
+    reset();
+    auto t = time_ms([&]() {
+        std::sort(policy, particles.begin(), particles.end(),
+                  [&](auto const& a, auto const& b) { return cf(a.iCell()) < cf(b.iCell()); });
+    });
+    auto ok = std::is_sorted(particles.iCells.begin(), particles.iCells.end(),
+                             [&](auto const& a, auto const& b) { return cf(a) < cf(b); });
+    PRINT(name << " sort       " << t << " ms valid " << ok);
+
+    reset();
+    t = time_ms([&]() {
+        std::partition(policy, particles.begin(), particles.end(),
+                       [](auto const& p) { return p.iCell()[0] < 50; });
+    });
+    ok = as_sorted(particles.iCells) == sorted_cells and
+         std::is_partitioned(particles.iCells.begin(), particles.iCells.end(),
+                             [](auto const& c) { return c[0] < 50; });
+    PRINT(name << " partition  " << t << " ms valid " << ok);
+
+    reset();
+    t = time_ms([&]() {
+        std::for_each(policy, particles.begin(), particles.end(),
+                      [](auto&& p) {
+                          if constexpr (std::is_same_v<Particles, SoAParticleArray>)
+                              p.move({1, 0, 0});  // keeps the cached key in sync
+                          else
+                              p.iCell()[0] += 1;
+                      });
+    });
+    ok = true;
+    for (std::size_t i = 0; i < cells.size(); ++i)
+        ok &= particles.iCells[i][0] == cells[i][0] + 1;
+    PRINT(name << " for_each   " << t << " ms valid " << ok);
+}
+
+template <typename Policy>
+void run_iter(std::string const& name, Policy&& policy, std::vector<std::size_t> const& values) {
+    auto v = values;
+    auto t = time_ms([&]() { std::sort(policy, _begin(v), _end(v)); });
+    PRINT(name << " sort       " << t << " ms valid " << std::is_sorted(v.begin(), v.end()));
+
+    v = values;
+    t = time_ms([&]() {
+        std::partition(policy, _begin(v), _end(v), [](auto const& i) { return i % 2 == 0; });
+    });
+    auto ok = std::is_partitioned(v.begin(), v.end(), [](auto const& i) { return i % 2 == 0; });
+    PRINT(name << " partition  " << t << " ms valid " << ok);
+
+    v = values;
+    t = time_ms([&]() { std::for_each(policy, _begin(v), _end(v), [](auto& i) { i += 1; }); });
+    ok = true;
+    for (std::size_t i = 0; i < v.size(); ++i) ok &= v[i] == values[i] + 1;
+    PRINT(name << " for_each   " << t << " ms valid " << ok);
+}
+
+int main(int argc, char** argv) {
+    std::size_t const n_particles = argc > 1 ? std::atoll(argv[1]) : 1e7;
+    auto const cells = random_cells(n_particles);
+    std::vector<std::size_t> values(n_particles);
+    std::transform(cells.begin(), cells.end(), values.begin(),
+                   [](auto const& c) { return c[0] * 10000 + c[1] * 100 + c[2]; });
+
+    PRINT("particles " << n_particles);
+
+    {
+        // ParticleIteratorAdapter hands out a mutable per-iterator scratch as the reference,
+        //  which is not safe to share between threads, so it only runs sequentially
+        ParticleArray particles;
+        run_particles("adapter seq      ", std::execution::seq, particles, cells);
+    }
+    {
+        SoAParticleArray particles{box_t{{0, 0, 0}, {99, 99, 99}}};
+        run_particles("zip     seq      ", std::execution::seq, particles, cells);
+        run_particles("zip     par      ", std::execution::par, particles, cells);
+        run_particles("zip     par_unseq", std::execution::par_unseq, particles, cells);
+    }
+
+    run_iter("iter    seq      ", std::execution::seq, values);
+    run_iter("iter    par      ", std::execution::par, values);
+    run_iter("iter    par_unseq", std::execution::par_unseq, values);
+}
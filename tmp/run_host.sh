@@ -0,0 +1,19 @@
+set -exu
+
+CWD="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )" && cd $CWD
+
+# soa_thrust.cpp without a GPU
+#  std (default) : std parallel algorithms on TBB
+#  omp / tbb     : thrust host system, thrust headers must be on the include path
+BACKEND="${1:-std}"
+
+ARGS="-std=c++17"
+LIBS="-ltbb"
+[ "$BACKEND" == "omp" ] && ARGS="$ARGS -fopenmp -DTHRUST_DEVICE_SYSTEM=THRUST_DEVICE_SYSTEM_OMP" && LIBS="-fopenmp"
+[ "$BACKEND" == "tbb" ] && ARGS="$ARGS -DTHRUST_DEVICE_SYSTEM=THRUST_DEVICE_SYSTEM_TBB"
+
+time (
+
+  mkn build run -M soa_thrust.cpp -a "$ARGS" -l "$LIBS" -O 2
+
+) 1> >(tee $CWD/.mkn.sh.out ) 2> >(tee $CWD/.mkn.sh.err >&2 )
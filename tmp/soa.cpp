@@ -1,179 +1,5 @@
-#include <array>
-#include <vector>
-#include <cassert>
-#include <cstdint>
-#include <iostream>
-#include <algorithm>
-
-#define PRINT(x) std::cout << __LINE__ << " " << x << std::endl;
-#define abort_if(x)                         \
-    if (x) {                                \
-        std::cout << __LINE__ << std::endl; \
-        std::abort();                       \
-    }
-
-struct ParticleIteratorAdapter;
-struct ParticleArrayIterator;
-
-struct P {
-    P() {}
-    P(std::array<int, 3> const& ic) : iCell_{ic} {}
-    P(ParticleIteratorAdapter const& that);
-
-    auto& iCell() { return iCell_; }
-    auto& iCell() const { return iCell_; }
-
-    std::array<int, 3> iCell_;
-};
-
-template <std::size_t dim>
-struct Box {
-    auto constexpr static dimension = dim;
-
-    std::array<int, dim> lower;
-    std::array<int, dim> upper;
-    auto shape() const {
-        std::array<int, dim> s;
-        for (std::uint16_t i = 0; i < dim; ++i) s[i] = upper[i] - lower[i] + i;
-        return s;
-    };
-};
-
-template <typename Box_t, typename RValue = std::size_t>
-struct CellFlattener {
-    template <typename Icell>
-    RValue operator()(Icell const& icell) const {
-        if constexpr (Box_t::dimension == 2) return icell[1] + icell[0] * shape[1] * shape[0];
-        if constexpr (Box_t::dimension == 3)
-            return icell[2] + icell[1] * shape[2] + icell[0] * shape[1] * shape[2];
-        return icell[0];
-    }
-    Box_t const box;
-    std::array<int, Box_t::dimension> shape = box.shape();
-};
-
-struct ParticleArray {
-    std::vector<std::array<int, 3>> iCells;
-    void push_back(std::array<int, 3> const& i) { iCells.push_back(i); }
-    void swap(std::size_t const& a, std::size_t const& b) {
-        if (a == b) return;
-        std::swap(iCells[a], iCells[b]);
-    }
-    auto size() const { return iCells.size(); }
-    ParticleArrayIterator begin();
-    ParticleArrayIterator end();
-
-    template <typename CF>
-    void print(CF const& flattener) {
-        for (auto const& iCell : iCells)
-            std::cout << __LINE__ << " " << flattener(iCell) << std::endl;
-        std::cout << std::endl;
-    }
-};
-
-struct ParticleIteratorAdapter {  // dereferencing adapter
-    using This = ParticleIteratorAdapter;
-
-    ParticleIteratorAdapter() = delete;
-    ParticleIteratorAdapter(ParticleArray* ps_, std::size_t index) : ps{ps_}, index_{index} {}
-    ParticleIteratorAdapter(ParticleIteratorAdapter const& that)
-        : ps{that.ps}, index_{that.index_} {}
-    ParticleIteratorAdapter(ParticleIteratorAdapter&&) = default;
-
-    auto& operator=(P const& that) {
-        ps->iCells[index_] = that.iCell();
-        return *this;
-    }
-
-    This& operator=(This&& that) { return *this = that; }
-    This& operator=(This const& that) {
-        if (ref == 1) {
-            ps->iCells[index_] = ps->iCells[that.index_];
-        } else
-            copy.iCell() = ps->iCells[that.index_];
-        return *this;
-    }
-
-    auto& iCell() { return ps->iCells[index_]; }
-    auto& iCell() const { return ps->iCells[index_]; }
-
-    auto& set_ref(std::size_t index) {
-        ref = 1;
-        index_ = index;
-        return *this;
-    }
-
-    ParticleArray* ps = nullptr;
-    std::size_t index_;
-    P copy;
-    bool ref = 0;  // 0=copy, 1=ref
-};
-
-P::P(ParticleIteratorAdapter const& that) : iCell_{that.iCell()} {}
-
-struct ParticleArrayIterator {
-    using This = ParticleArrayIterator;
-    using difference_type = std::size_t;
-    using value_type = P;
-    using reference = ParticleIteratorAdapter&;
-    using pointer = ParticleIteratorAdapter*;
-    using iterator_category = std::random_access_iterator_tag;
-
-    ParticleArrayIterator() = delete;
-    ParticleArrayIterator(ParticleArray& ps, std::size_t i = 0) : particles{ps}, index_{i} {};
-    ParticleArrayIterator(This&& that) = default;
-    ParticleArrayIterator(This const& that) = default;
-
-    auto& operator=(This const& that) {
-        index_ = that.index_;
-        return *this;
-    }
-    auto& operator=(This&& that) {
-        index_ = that.index_;
-        return *this;
-    }
-
-    auto& operator++() {
-        ++index_;
-        return *this;
-    }
-    auto& operator+=(std::int64_t i) {
-        index_ += i;
-        return *this;
-    }
-
-    auto operator+(std::int64_t i) const {
-        auto copy = *this;
-        copy.index_ += i;
-        return copy;
-    }
-
-    auto& operator--() {
-        --index_;
-        return *this;
-    }
-    auto operator-(This const& that) const { return index_ - that.index_; }
-    auto operator-(std::int64_t i) const {
-        auto copy = *this;
-        copy.index_ -= i;
-        return copy;
-    }
-    auto operator==(This const& that) const {
-        return &particles == &that.particles and index_ == that.index_;
-    }
-    auto operator!=(This const& that) const { return !(*this == that); }
-    auto& operator*() const { return scratch.set_ref(index_); }
-    auto operator<(This const& that) const { return index_ < that.index_; }
-
-    ParticleArray& particles;
-    std::size_t index_ = 0;
-
-    // PRIVATE HANDS OFF
-    mutable ParticleIteratorAdapter scratch{&particles, 0};
-};
-
-ParticleArrayIterator ParticleArray::begin() { return ParticleArrayIterator{*this}; }
-ParticleArrayIterator ParticleArray::end() { return ParticleArrayIterator{*this, size()}; }
+
+#include "soa.hpp"
 
 std::vector<std::array<int, 3>> iCells{{2, 2, 2}, {0, 0, 0}, {0, 0, 0},  //
                                        {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
@@ -189,20 +15,163 @@ std::vector<std::array<int, 3>> expected{{0, 0, 0}, {0, 0, 0}, {0, 0, 0},  //
 //                                          {1, 0, 1}, {1, 1, 1}, {1, 1, 2},
 //                                          {2, 0, 2}, {2, 1, 0}, {2, 2, 2}};
 
-int main() {
+template <typename Particles, typename CF>
+auto is_sorted(Particles const& iCells, CF const& cf) {
+    return std::is_sorted(iCells.begin(), iCells.end(),
+                          [&](auto const& a, auto const& b) { return cf(a) < cf(b); });
+}
+
+template <typename Particles>
+auto same_cells(Particles iCells, std::vector<std::array<int, 3>> const& sorted_cells) {
+    std::sort(iCells.begin(), iCells.end());
+    return iCells == sorted_cells;
+}
+
+// adapter vs zip iterator, the adapter array only carries iCells so it moves less data
+void bench(std::size_t n_particles) {
+    using box_t = Box<3>;
+    box_t domain{{0, 0, 0}, {99, 99, 99}};
+    CellFlattener<box_t> cf{domain};
+    auto const by_cell = [&](auto const& a, auto const& b) {
+        return cf(a.iCell()) < cf(b.iCell());
+    };
+    auto const in_lower_half = [&](auto const& p) { return p.iCell()[0] < 50; };
+
+    std::mt19937_64 gen{1337};
+    std::uniform_int_distribution<int> dist{0, 99};
+    std::uniform_real_distribution<double> ddist{0, 1};
+    std::vector<std::array<int, 3>> cells(n_particles);
+    for (auto& c : cells) c = {dist(gen), dist(gen), dist(gen)};
+    auto sorted_cells = cells;
+    std::sort(sorted_cells.begin(), sorted_cells.end());
+
+    ParticleArray adapted;
+    SoAParticleArray zipped{domain};
+    auto const reset = [&]() {
+        adapted.iCells = cells;
+        zipped = SoAParticleArray{domain};
+        zipped.reserve(n_particles);
+        for (auto const& c : cells) zipped.push_back(c, {ddist(gen), ddist(gen), ddist(gen)});
+    };
+    auto const partitioned = [&](auto const& iCells) {
+        return same_cells(iCells, sorted_cells) and
+               std::is_partitioned(iCells.begin(), iCells.end(),
+                                   [](auto const& c) { return c[0] < 50; });
+    };
+
+    PRINT("particles " << n_particles);
+
+    reset();
+    auto t = time_ms([&]() { std::sort(adapted.begin(), adapted.end(), by_cell); });
+    PRINT("adapter sort           " << t << " ms sorted " << is_sorted(adapted.iCells, cf));
+    t = time_ms([&]() { std::sort(zipped.begin(), zipped.end(), by_cell); });
+    PRINT("zip     sort           " << t << " ms sorted " << is_sorted(zipped.iCells, cf));
+
+    reset();
+    t = time_ms([&]() { std::stable_sort(adapted.begin(), adapted.end(), by_cell); });
+    PRINT("adapter stable_sort    " << t << " ms sorted " << is_sorted(adapted.iCells, cf));
+    t = time_ms([&]() { std::stable_sort(zipped.begin(), zipped.end(), by_cell); });
+    PRINT("zip     stable_sort    " << t << " ms sorted " << is_sorted(zipped.iCells, cf));
+
+    reset();
+    t = time_ms([&]() { std::partition(adapted.begin(), adapted.end(), in_lower_half); });
+    PRINT("adapter partition      " << t << " ms valid " << partitioned(adapted.iCells));
+    t = time_ms([&]() { std::partition(zipped.begin(), zipped.end(), in_lower_half); });
+    PRINT("zip     partition      " << t << " ms valid " << partitioned(zipped.iCells));
+}
+
+// flattening the cell per comparison/access vs the cached keys
+void bench_keys(std::size_t n_particles) {
+    using box_t = Box<3>;
+    box_t domain{{0, 0, 0}, {99, 99, 99}};
+    CellFlattener<box_t> cf{domain};
+    SoAParticleArray particles{domain};
+
+    auto const reset = [&]() {  // same seed, same particles
+        std::mt19937_64 gen{1337};
+        std::uniform_int_distribution<int> dist{0, 99};
+        particles = SoAParticleArray{domain};
+        particles.reserve(n_particles);
+        for (std::size_t i = 0; i < n_particles; ++i)
+            particles.push_back({dist(gen), dist(gen), dist(gen)}, {}, 1 + i % 7);
+    };
+
+    PRINT("particles " << n_particles);
+
+    reset();
+    auto t = time_ms([&]() {
+        std::sort(particles.begin(), particles.end(),
+                  [&](auto const& a, auto const& b) { return cf(a.iCell()) < cf(b.iCell()); });
+    });
+    PRINT("flatten sort           " << t << " ms sorted " << is_sorted(particles.iCells, cf));
+
+    reset();
+    t = time_ms([&]() { particles.sort(); });
+    PRINT("keyed   sort           " << t << " ms sorted " << is_sorted(particles.iCells, cf));
+
+    std::mt19937_64 gen{7};
+    std::uniform_int_distribution<int> dist{0, 99};
+    std::vector<std::array<int, 3>> wanted(1000);
+    for (auto& c : wanted) c = {dist(gen), dist(gen), dist(gen)};
+
+    std::size_t flatten_found = 0, keyed_found = 0;
+    t = time_ms([&]() {
+        for (auto const& c : wanted) {
+            auto const [lo, hi] = std::equal_range(
+                particles.iCells.begin(), particles.iCells.end(), c,
+                [&](auto const& a, auto const& b) { return cf(a) < cf(b); });
+            flatten_found += hi - lo;
+        }
+    });
+    PRINT("flatten select         " << t << " ms found " << flatten_found);
+    t = time_ms([&]() {
+        for (auto const& c : wanted) {
+            auto const [lo, hi] = particles.select(c);
+            keyed_found += hi - lo;
+        }
+    });
+    PRINT("keyed   select         " << t << " ms found " << keyed_found);
+
+    std::vector<double> flatten_density(particles.field_size());
+    std::vector<double> keyed_density(particles.field_size());
+    t = time_ms([&]() {
+        for (std::size_t i = 0; i < particles.size(); ++i)
+            flatten_density[cf(particles.iCells[i])] += particles.weights[i];
+    });
+    PRINT("flatten deposit        " << t << " ms");
+    t = time_ms([&]() { particles.deposit(keyed_density); });
+    PRINT("keyed   deposit        " << t << " ms same " << (flatten_density == keyed_density));
+}
+
+int main(int argc, char** argv) {
     using box_t = Box<3>;
-    ParticleArray particles;
     box_t domain{{0, 0, 0}, {2, 2, 2}};
+    ParticleArray particles;
+    SoAParticleArray soa_particles{domain};
     CellFlattener<box_t> cf{domain};
     for (auto const& iCell : iCells) particles.push_back(iCell);
+    for (auto const& iCell : iCells) soa_particles.push_back(iCell);
 
     particles.print(cf);
 
     std::sort(particles.begin(), particles.end(),
               [&](auto const& a, auto const& b) { return cf(a.iCell()) < cf(b.iCell()); });
+    std::sort(soa_particles.begin(), soa_particles.end(),
+              [&](auto const& a, auto const& b) { return cf(a.iCell()) < cf(b.iCell()); });
 
     particles.print(cf);
 
     for (std::size_t i = 0; i < particles.size(); ++i)
         if (particles.iCells[i] != expected[i]) return 1;
+    for (std::size_t i = 0; i < soa_particles.size(); ++i)
+        if (soa_particles.iCells[i] != expected[i]) return 1;
+
+    // keys must follow particles that change cell
+    soa_particles.move(0, {0, 1, 0});
+    if (soa_particles.keys[0] != cf(soa_particles.iCells[0])) return 1;
+    soa_particles[1].set_iCell({1, 1, 1});
+    if (soa_particles.keys[1] != cf(std::array<int, 3>{1, 1, 1})) return 1;
+
+    bench(argc > 1 ? std::atoll(argv[1]) : 1e7);
+    bench_keys(argc > 2 ? std::atoll(argv[2]) : 1e8);
 }
@@ -0,0 +1,404 @@
+#include <array>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+
+#define PRINT(x) std::cout << __LINE__ << " " << x << std::endl;
+#define abort_if(x)                         \
+    if (x) {                                \
+        std::cout << __LINE__ << std::endl; \
+        std::abort();                       \
+    }
+
+struct ParticleIteratorAdapter;
+struct ParticleArrayIterator;
+
+struct P {
+    P() {}
+    P(std::array<int, 3> const& ic) : iCell_{ic} {}
+    P(ParticleIteratorAdapter const& that);
+
+    auto& iCell() { return iCell_; }
+    auto& iCell() const { return iCell_; }
+
+    std::array<int, 3> iCell_;
+};
+
+template <std::size_t dim>
+struct Box {
+    auto constexpr static dimension = dim;
+
+    std::array<int, dim> lower;
+    std::array<int, dim> upper;
+    auto shape() const {
+        std::array<int, dim> s;
+        for (std::uint16_t i = 0; i < dim; ++i) s[i] = upper[i] - lower[i] + i;
+        return s;
+    };
+};
+
+template <typename Box_t, typename RValue = std::size_t>
+struct CellFlattener {
+    template <typename Icell>
+    RValue operator()(Icell const& icell) const {
+        if constexpr (Box_t::dimension == 2) return icell[1] + icell[0] * shape[1] * shape[0];
+        if constexpr (Box_t::dimension == 3)
+            return icell[2] + icell[1] * shape[2] + icell[0] * shape[1] * shape[2];
+        return icell[0];
+    }
+    Box_t box;
+    std::array<int, Box_t::dimension> shape = box.shape();
+};
+
+struct ParticleArray {
+    std::vector<std::array<int, 3>> iCells;
+    void push_back(std::array<int, 3> const& i) { iCells.push_back(i); }
+    void swap(std::size_t const& a, std::size_t const& b) {
+        if (a == b) return;
+        std::swap(iCells[a], iCells[b]);
+    }
+    auto size() const { return iCells.size(); }
+    ParticleArrayIterator begin();
+    ParticleArrayIterator end();
+
+    template <typename CF>
+    void print(CF const& flattener) {
+        for (auto const& iCell : iCells)
+            std::cout << __LINE__ << " " << flattener(iCell) << std::endl;
+        std::cout << std::endl;
+    }
+};
+
+struct ParticleIteratorAdapter {  // dereferencing adapter
+    using This = ParticleIteratorAdapter;
+
+    ParticleIteratorAdapter() = delete;
+    ParticleIteratorAdapter(ParticleArray* ps_, std::size_t index) : ps{ps_}, index_{index} {}
+    ParticleIteratorAdapter(ParticleIteratorAdapter const& that)
+        : ps{that.ps}, index_{that.index_} {}
+    ParticleIteratorAdapter(ParticleIteratorAdapter&&) = default;
+
+    auto& operator=(P const& that) {
+        ps->iCells[index_] = that.iCell();
+        return *this;
+    }
+
+    This& operator=(This&& that) { return *this = that; }
+    This& operator=(This const& that) {
+        if (ref == 1) {
+            ps->iCells[index_] = ps->iCells[that.index_];
+        } else
+            copy.iCell() = ps->iCells[that.index_];
+        return *this;
+    }
+
+    auto& iCell() { return ps->iCells[index_]; }
+    auto& iCell() const { return ps->iCells[index_]; }
+
+    auto& set_ref(std::size_t index) {
+        ref = 1;
+        index_ = index;
+        return *this;
+    }
+
+    // std::swap would move construct a temporary adapter still referencing "a"
+    friend void swap(This& a, This& b) { std::swap(a.iCell(), b.iCell()); }
+
+    ParticleArray* ps = nullptr;
+    std::size_t index_;
+    P copy;
+    bool ref = 0;  // 0=copy, 1=ref
+};
+
+P::P(ParticleIteratorAdapter const& that) : iCell_{that.iCell()} {}
+
+struct ParticleArrayIterator {
+    using This = ParticleArrayIterator;
+    using difference_type = std::ptrdiff_t;
+    using value_type = P;
+    using reference = ParticleIteratorAdapter&;
+    using pointer = ParticleIteratorAdapter*;
+    using iterator_category = std::random_access_iterator_tag;
+
+    ParticleArrayIterator() = default;
+    ParticleArrayIterator(ParticleArray& ps, std::size_t i = 0) : particles{&ps}, index_{i} {};
+    ParticleArrayIterator(This&& that) = default;
+    ParticleArrayIterator(This const& that) = default;
+
+    // the adapter's assignment writes through to the array, so scratch is rebound, not assigned
+    auto& operator=(This const& that) {
+        particles = that.particles;
+        index_ = that.index_;
+        scratch.ps = particles;
+        return *this;
+    }
+    auto& operator=(This&& that) { return *this = that; }
+
+    auto& operator++() {
+        ++index_;
+        return *this;
+    }
+    auto operator++(int) {
+        auto copy = *this;
+        ++index_;
+        return copy;
+    }
+    auto& operator+=(difference_type i) {
+        index_ += i;
+        return *this;
+    }
+    auto& operator-=(difference_type i) {
+        index_ -= i;
+        return *this;
+    }
+
+    auto operator+(difference_type i) const {
+        auto copy = *this;
+        copy.index_ += i;
+        return copy;
+    }
+    friend auto operator+(difference_type i, This const& that) { return that + i; }
+
+    auto& operator--() {
+        --index_;
+        return *this;
+    }
+    auto operator--(int) {
+        auto copy = *this;
+        --index_;
+        return copy;
+    }
+    difference_type operator-(This const& that) const { return index_ - that.index_; }
+    auto operator-(difference_type i) const {
+        auto copy = *this;
+        copy.index_ -= i;
+        return copy;
+    }
+    auto operator==(This const& that) const {
+        return particles == that.particles and index_ == that.index_;
+    }
+    auto operator!=(This const& that) const { return !(*this == that); }
+    auto& operator*() const { return scratch.set_ref(index_); }
+    auto& operator[](difference_type i) const { return scratch.set_ref(index_ + i); }
+    auto operator<(This const& that) const { return index_ < that.index_; }
+    auto operator>(This const& that) const { return index_ > that.index_; }
+    auto operator<=(This const& that) const { return index_ <= that.index_; }
+    auto operator>=(This const& that) const { return index_ >= that.index_; }
+
+    ParticleArray* particles = nullptr;
+    std::size_t index_ = 0;
+
+    // PRIVATE HANDS OFF
+    mutable ParticleIteratorAdapter scratch{particles, 0};
+};
+
+ParticleArrayIterator ParticleArray::begin() { return ParticleArrayIterator{*this}; }
+ParticleArrayIterator ParticleArray::end() { return ParticleArrayIterator{*this, size()}; }
+
+// SoA particles with a zip iterator
+//  the iterator is just (array*, index), dereferencing yields a proxy of references into each
+//  field array, so copies are cheap and there is no ref/copy branch in the hot path
+//  the flattened cell of each particle is cached in "keys", iCell is only writable through
+//  set_iCell/move so the key can not go stale
+
+struct SoAParticleArray;
+using SoAFlattener = CellFlattener<Box<3>>;
+
+struct SoAParticle {  // value_type, what std algorithms hold in temporaries
+    std::array<int, 3> const& iCell() const { return iCell_; }
+    auto& delta() { return delta_; }
+    auto& delta() const { return delta_; }
+    auto& weight() { return weight_; }
+    auto& weight() const { return weight_; }
+    std::size_t const& key() const { return key_; }
+
+    std::array<int, 3> iCell_;
+    std::array<double, 3> delta_;
+    double weight_;
+    std::size_t key_;
+};
+
+struct SoAParticleRef {  // reference proxy, assignment writes through to the arrays
+    using This = SoAParticleRef;
+
+    SoAParticleRef(SoAParticleArray& ps, std::size_t i);
+    SoAParticleRef(This const&) = default;
+
+    This& operator=(This const& that) {
+        iCell_ = that.iCell_;
+        delta_ = that.delta_;
+        weight_ = that.weight_;
+        key_ = that.key_;
+        return *this;
+    }
+    This& operator=(SoAParticle const& that) {
+        iCell_ = that.iCell_;
+        delta_ = that.delta_;
+        weight_ = that.weight_;
+        key_ = that.key_;
+        return *this;
+    }
+
+    operator SoAParticle() const { return {iCell_, delta_, weight_, key_}; }
+
+    friend void swap(This a, This b) {
+        std::swap(a.iCell_, b.iCell_);
+        std::swap(a.delta_, b.delta_);
+        std::swap(a.weight_, b.weight_);
+        std::swap(a.key_, b.key_);
+    }
+
+    // iCell and key are read only, a reference member would hand out a mutable array
+    std::array<int, 3> const& iCell() const { return iCell_; }
+    auto& delta() const { return delta_; }
+    auto& weight() const { return weight_; }
+    std::size_t const& key() const { return key_; }
+
+    void set_iCell(std::array<int, 3> const& iCell) {
+        iCell_ = iCell;
+        key_ = (*cf_)(iCell_);
+    }
+    void move(std::array<int, 3> const& by) {
+        for (std::uint16_t i = 0; i < 3; ++i) iCell_[i] += by[i];
+        key_ = (*cf_)(iCell_);
+    }
+
+    std::array<int, 3>& iCell_;
+    std::array<double, 3>& delta_;
+    double& weight_;
+    std::size_t& key_;
+    SoAFlattener const* cf_;
+};
+
+struct SoAParticleIterator {
+    using This = SoAParticleIterator;
+    using difference_type = std::ptrdiff_t;
+    using value_type = SoAParticle;
+    using reference = SoAParticleRef;
+    using pointer = void;
+    using iterator_category = std::random_access_iterator_tag;
+
+    reference operator*() const { return {*particles, static_cast<std::size_t>(index_)}; }
+    reference operator[](difference_type i) const {
+        return {*particles, static_cast<std::size_t>(index_ + i)};
+    }
+
+    auto& operator++() {
+        ++index_;
+        return *this;
+    }
+    auto operator++(int) {
+        auto copy = *this;
+        ++index_;
+        return copy;
+    }
+    auto& operator--() {
+        --index_;
+        return *this;
+    }
+    auto operator--(int) {
+        auto copy = *this;
+        --index_;
+        return copy;
+    }
+    auto& operator+=(difference_type i) {
+        index_ += i;
+        return *this;
+    }
+    auto& operator-=(difference_type i) {
+        index_ -= i;
+        return *this;
+    }
+    auto operator+(difference_type i) const { return This{particles, index_ + i}; }
+    auto operator-(difference_type i) const { return This{particles, index_ - i}; }
+    friend auto operator+(difference_type i, This const& that) { return that + i; }
+    auto operator-(This const& that) const { return index_ - that.index_; }
+
+    auto operator==(This const& that) const { return index_ == that.index_; }
+    auto operator!=(This const& that) const { return index_ != that.index_; }
+    auto operator<(This const& that) const { return index_ < that.index_; }
+    auto operator>(This const& that) const { return index_ > that.index_; }
+    auto operator<=(This const& that) const { return index_ <= that.index_; }
+    auto operator>=(This const& that) const { return index_ >= that.index_; }
+
+    SoAParticleArray* particles = nullptr;
+    difference_type index_ = 0;
+};
+static_assert(std::is_trivially_copyable_v<SoAParticleIterator>);
+
+struct SoAParticleArray {
+    explicit SoAParticleArray(Box<3> const& box) : cf{box} {}
+
+    void push_back(std::array<int, 3> const& i, std::array<double, 3> const& d = {},
+                   double w = 1) {
+        iCells.push_back(i);
+        deltas.push_back(d);
+        weights.push_back(w);
+        keys.push_back(cf(i));
+    }
+    // a template so push_back({i, j, k}) only matches the cell overload above, a braced list
+    //  deduces nothing. takes SoAParticle and the SoAParticleRef proxy
+    template<typename P, typename = std::enable_if_t<std::is_convertible_v<P const&, SoAParticle>>>
+    void push_back(P const& that) {
+        SoAParticle const p = that;
+        push_back(p.iCell(), p.delta(), p.weight());
+    }
+    void reserve(std::size_t n) {
+        iCells.reserve(n);
+        deltas.reserve(n);
+        weights.reserve(n);
+        keys.reserve(n);
+    }
+
+    auto size() const { return iCells.size(); }
+    auto begin() { return SoAParticleIterator{this, 0}; }
+    auto end() { return SoAParticleIterator{this, static_cast<std::ptrdiff_t>(size())}; }
+    SoAParticleRef operator[](std::size_t i) { return {*this, i}; }
+
+    void set_iCell(std::size_t i, std::array<int, 3> const& iCell) { (*this)[i].set_iCell(iCell); }
+    void move(std::size_t i, std::array<int, 3> const& by) { (*this)[i].move(by); }
+
+    void sort() {
+        std::sort(begin(), end(), [](auto const& a, auto const& b) { return a.key() < b.key(); });
+    }
+
+    // index range [first, last) of the particles in iCell, requires sort()
+    auto select(std::array<int, 3> const& iCell) const {
+        auto const [lo, hi] = std::equal_range(keys.begin(), keys.end(), cf(iCell));
+        return std::make_pair(lo - keys.begin(), hi - keys.begin());
+    }
+
+    // weights summed per cell, the field is indexed by key
+    void deposit(std::vector<double>& density) const {
+        for (std::size_t i = 0; i < size(); ++i) density[keys[i]] += weights[i];
+    }
+    auto field_size() const { return cf(cf.box.upper) + 1; }
+
+    SoAFlattener cf;
+    std::vector<std::array<int, 3>> iCells;
+    std::vector<std::array<double, 3>> deltas;
+    std::vector<double> weights;
+    std::vector<std::size_t> keys;
+};
+
+SoAParticleRef::SoAParticleRef(SoAParticleArray& ps, std::size_t i)
+    : iCell_{ps.iCells[i]},
+      delta_{ps.deltas[i]},
+      weight_{ps.weights[i]},
+      key_{ps.keys[i]},
+      cf_{&ps.cf} {}
+
+template <typename Fn>
+auto time_ms(Fn&& fn) {
+    auto const start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
@@ -1,22 +1,47 @@
-
+// backends, all run the same flatten -> sort_by_key -> gather pipeline
+//  MKN_GPU_ROCM/MKN_GPU_CUDA : thrust on the device with managed memory, see run.sh
+//  THRUST_DEVICE_SYSTEM      : thrust on a host system (OMP/TBB), no GPU needed
+//  neither                   : std parallel algorithms (TBB backed in libstdc++)
+//   see run_host.sh for the host builds
+
+#if defined(MKN_GPU_ROCM) || defined(MKN_GPU_CUDA)
+#define SOA_THRUST_GPU 1
+#endif
+
+#if defined(SOA_THRUST_GPU) || defined(THRUST_DEVICE_SYSTEM)
+#include <thrust/copy.h>
 #include <thrust/sort.h>
 #include <thrust/gather.h>
 #include <thrust/sequence.h>
+#include <thrust/transform.h>
 #include <thrust/functional.h>
 #include <thrust/device_vector.h>
 #include <thrust/execution_policy.h>
+#include <thrust/iterator/counting_iterator.h>
+#else
+#include <numeric>
+#include <execution>
+#endif
 
+#if defined(SOA_THRUST_GPU)
 #include "mkn/gpu.hpp"
+#endif
 
 #include <array>
+#include <random>
 #include <vector>
 #include <cassert>
 #include <cstdint>
 #include <iostream>
 #include <algorithm>
 
+#if defined(SOA_THRUST_GPU)
 #define _DEV_FN_ __device__
 #define _HST_FN_ __host__
+#else
+#define _DEV_FN_
+#define _HST_FN_
+#endif
 #define _ALL_FN_ _HST_FN_ _DEV_FN_
 
 #define PRINT(x) std::cout << __LINE__ << " " << x << std::endl;
@@ -26,8 +51,13 @@
         std::abort();                       \
     }
 
+#if defined(SOA_THRUST_GPU)
 template <typename T>
 using ManagedVector = std::vector<T, mkn::gpu::ManagedAllocator<T>>;
+#else
+template <typename T>
+using ManagedVector = std::vector<T>;
+#endif
 
 template <typename ParticleArray_t>
 struct ParticleIteratorAdapter;
@@ -300,7 +330,73 @@ std::vector<std::array<int, 3>> expected{{0, 0, 0}, {0, 0, 0}, {0, 0, 0},  //
 //                                          {1, 0, 1}, {1, 1, 1}, {1, 1, 2},
 //                                          {2, 0, 2}, {2, 1, 0}, {2, 2, 2}};
 
-int main() {
+// sorts particles [l, r) of the view by flattened cell
+template <typename CF>
+void sort(ParticleArrayViewMediator& ps, CF const& cf, std::size_t l, std::size_t r) {
+    auto v = &ps.views[0];
+    ManagedVector<int> flats(r - l);
+    auto fv = flats.data();
+
+#if defined(SOA_THRUST_GPU)
+    mkn::gpu::GDLauncher{flats.size()}([=, cf = cf] _ALL_FN_() {
+        auto idx = mkn::gpu::idx() + l;
+        fv[mkn::gpu::idx()] = cf(v->iCells[idx]);  // cf(ps.iCell(idx));
+    });
+    thrust::device_vector<int> indices(flats.size());
+    thrust::sequence(indices.begin(), indices.end());
+    thrust::sort_by_key(thrust::device, fv, fv + flats.size(), indices.begin());
+    thrust::gather(thrust::device, indices.begin(), indices.end(), ps.begin() + l, ps.begin() + l);
+
+#elif defined(THRUST_DEVICE_SYSTEM)  // thrust::device is the host system here
+    thrust::transform(thrust::device, thrust::counting_iterator<std::size_t>(l),
+                      thrust::counting_iterator<std::size_t>(r), fv,
+                      [=](auto idx) { return cf(v->iCells[idx]); });
+    thrust::device_vector<int> indices(flats.size());
+    thrust::sequence(indices.begin(), indices.end());
+    thrust::sort_by_key(thrust::device, fv, fv + flats.size(), indices.begin());
+    ManagedVector<std::array<int, 3>> gathered(flats.size());  // gather must not overlap
+    thrust::gather(thrust::device, indices.begin(), indices.end(), v->iCells + l,
+                   gathered.begin());
+    thrust::copy(thrust::device, gathered.begin(), gathered.end(), v->iCells + l);
+
+#else
+    auto constexpr policy = std::execution::par_unseq;
+    std::transform(policy, v->iCells + l, v->iCells + r, fv, cf);
+    std::vector<int> indices(flats.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    std::sort(policy, indices.begin(), indices.end(),
+              [=](auto const a, auto const b) { return fv[a] < fv[b]; });
+    ManagedVector<std::array<int, 3>> gathered(flats.size());  // gather must not overlap
+    std::transform(policy, indices.begin(), indices.end(), gathered.begin(),
+                   [=](auto const i) { return v->iCells[l + i]; });
+    std::copy(policy, gathered.begin(), gathered.end(), v->iCells + l);
+#endif
+}
+
+// larger input checked against std::sort on the host, equal keys are equal cells
+//  so every backend has to produce the identical array
+bool check_random(std::size_t n_particles) {
+    using box_t = Box<3>;
+    box_t domain{{0, 0, 0}, {9, 9, 9}};
+    CellFlattener<box_t> cf{domain};
+
+    std::mt19937_64 gen{1337};
+    std::uniform_int_distribution<int> dist{0, 9};
+    ParticleArray particles;
+    for (std::size_t i = 0; i < n_particles; ++i)
+        particles.push_back({dist(gen), dist(gen), dist(gen)});
+
+    std::vector<std::array<int, 3>> expected(particles.iCells.begin(), particles.iCells.end());
+    std::stable_sort(expected.begin(), expected.end(),
+                     [&](auto const& a, auto const& b) { return cf(a) < cf(b); });
+
+    auto ps = particles.view();
+    sort(ps, cf, 0, particles.size());
+
+    return std::equal(expected.begin(), expected.end(), particles.iCells.begin());
+}
+
+int main(int argc, char** argv) {
     using box_t = Box<3>;
     ParticleArray particles;
     box_t domain{{0, 0, 0}, {2, 2, 2}};
@@ -313,8 +409,6 @@ int main() {
     //           [&](auto const& a, auto const& b) { return cf(a.iCell()) < cf(b.iCell()); });
 
     auto ps = particles.view();
-    auto v = &ps.views[0];
-    // auto b = ps.begin();
 
     PRINT(cf(ps.views[0].iCells[0]));
     PRINT("");
@@ -325,21 +419,12 @@ int main() {
     //                  cf(b.iCell())); return cf(a.iCell()) < cf(b.iCell());
     //              });
 
-    std::size_t l = 0;
-    std::size_t r = iCells.size();
-    ManagedVector<int> flats(r - l);
-    auto fv = flats.data();
-    mkn::gpu::GDLauncher{flats.size()}([=, cf = cf] _ALL_FN_() {
-        auto idx = mkn::gpu::idx() + l;
-        fv[mkn::gpu::idx()] = cf(v->iCells[idx]);  // cf(ps.iCell(idx));
-    });
-    thrust::device_vector<int> indices(flats.size());
-    thrust::sequence(indices.begin(), indices.end());
-    thrust::sort_by_key(thrust::device, fv, fv + flats.size(), indices.begin());
-    thrust::gather(thrust::device, indices.begin(), indices.end(), ps.begin() + l, ps.begin() + l);
+    sort(ps, cf, 0, iCells.size());
 
     particles.print(cf);
 
     for (std::size_t i = 0; i < particles.size(); ++i)
         if (particles.iCells[i] != expected[i]) return 1;
+
+    if (!check_random(argc > 1 ? std::atoll(argv[1]) : 1e6)) return 1;
 }